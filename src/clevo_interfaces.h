@@ -23,6 +23,7 @@
 
 #include <linux/types.h>
 #include <linux/acpi.h>
+#include <linux/notifier.h>
 
 #define CLEVO_WMI_EVENT_GUID		"ABBC0F6B-8EA1-11D1-00A0-C90629100000"
 #define CLEVO_WMI_EMAIL_GUID		"ABBC0F6C-8EA1-11D1-00A0-C90629100000"
@@ -85,6 +86,9 @@ int clevo_keyboard_remove_interface(struct clevo_interface_t *interface);
 int clevo_evaluate_method(u8 cmd, u32 arg, u32 *result);
 int clevo_evaluate_method2(u8 cmd, u32 arg, union acpi_object **result);
 int clevo_get_active_interface_id(char **id_str);
+// Notified with the raw event code as action, from atomic context
+int clevo_register_event_notifier(struct notifier_block *nb);
+int clevo_unregister_event_notifier(struct notifier_block *nb);
 
 #define MODULE_ALIAS_CLEVO_WMI() \
 	MODULE_ALIAS("wmi:" CLEVO_WMI_EVENT_GUID); \
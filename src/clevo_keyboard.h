@@ -24,10 +24,13 @@
 #include <linux/power_supply.h>
 #include <acpi/battery.h>
 #include <linux/version.h>
+#include <linux/ktime.h>
+#include <linux/notifier.h>
 
 #include "tuxedo_keyboard_common.h"
 #include "clevo_interfaces.h"
 #include "clevo_leds.h"
+#include "clevo_trace.h"
 
 // Clevo event codes
 #define CLEVO_EVENT_KB_LEDS_DECREASE		0x81
@@ -159,15 +162,19 @@ int clevo_evaluate_method(u8 cmd, u32 arg, u32 *result)
 {
 	int status = 0;
 	union acpi_object *out_obj;
+	u32 trace_result = 0;
+	u64 start_ns = ktime_get_ns();
 
 	status = clevo_evaluate_method2(cmd, arg, &out_obj);
 	if (status) {
+		trace_clevo_evaluate_method(cmd, arg, 0, ktime_get_ns() - start_ns, status);
 		return status;
 	}
 	else {
 		if (out_obj->type == ACPI_TYPE_INTEGER) {
+			trace_result = (u32) out_obj->integer.value;
 			if (!IS_ERR_OR_NULL(result))
-				*result = (u32) out_obj->integer.value;
+				*result = trace_result;
 		} else {
 			pr_err("return type not integer, use clevo_evaluate_method2\n");
 			status = -ENODATA;
@@ -175,6 +182,8 @@ int clevo_evaluate_method(u8 cmd, u32 arg, u32 *result)
 		ACPI_FREE(out_obj);
 	}
 
+	trace_clevo_evaluate_method(cmd, arg, trace_result, ktime_get_ns() - start_ns, status);
+
 	return status;
 }
 EXPORT_SYMBOL(clevo_evaluate_method);
@@ -191,6 +200,25 @@ int clevo_get_active_interface_id(char **id_str)
 }
 EXPORT_SYMBOL(clevo_get_active_interface_id);
 
+/*
+ * Raw interface events are passed on to other modules (tuxedo_io) before
+ * being handled here. Called from the interface notify context, callbacks
+ * must not sleep.
+ */
+static ATOMIC_NOTIFIER_HEAD(clevo_event_notifier);
+
+int clevo_register_event_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&clevo_event_notifier, nb);
+}
+EXPORT_SYMBOL(clevo_register_event_notifier);
+
+int clevo_unregister_event_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&clevo_event_notifier, nb);
+}
+EXPORT_SYMBOL(clevo_unregister_event_notifier);
+
 static void set_next_color_whole_kb(void)
 {
 	/* "Calculate" new to-be color */
@@ -292,6 +320,8 @@ static void clevo_keyboard_event_callb(u32 event)
 
 	TUXEDO_DEBUG("Clevo event: %0#6x\n", event);
 
+	atomic_notifier_call_chain(&clevo_event_notifier, event, NULL);
+
 	switch (key_event) {
 		case CLEVO_EVENT_GAUGE_KEY:
 			clevo_send_cc_combo();
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*!
+ * Copyright (c) 2025 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-drivers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tuxedo_clevo
+
+#if !defined(CLEVO_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define CLEVO_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(clevo_evaluate_method,
+
+	TP_PROTO(u8 cmd, u32 arg, u32 result, u64 duration_ns, int status),
+
+	TP_ARGS(cmd, arg, result, duration_ns, status),
+
+	TP_STRUCT__entry(
+		__field(u8, cmd)
+		__field(u32, arg)
+		__field(u32, result)
+		__field(u64, duration_ns)
+		__field(int, status)
+	),
+
+	TP_fast_assign(
+		__entry->cmd = cmd;
+		__entry->arg = arg;
+		__entry->result = result;
+		__entry->duration_ns = duration_ns;
+		__entry->status = status;
+	),
+
+	TP_printk("cmd=0x%02x arg=0x%08x result=0x%08x duration_ns=%llu status=%d",
+		  __entry->cmd, __entry->arg, __entry->result,
+		  __entry->duration_ns, __entry->status)
+);
+
+#endif // CLEVO_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE clevo_trace
+#include <trace/define_trace.h>
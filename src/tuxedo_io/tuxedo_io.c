@@ -30,13 +30,24 @@
 #include <linux/delay.h>
 #include <linux/version.h>
 #include <linux/dmi.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/kfifo.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/mm.h>
+#include <linux/powercap.h>
 #include "../clevo_interfaces.h"
 #include "../uniwill_interfaces.h"
 #include "tuxedo_io_ioctl.h"
 
 MODULE_DESCRIPTION("Hardware interface for TUXEDO laptops");
 MODULE_AUTHOR("TUXEDO Computers GmbH <tux@tuxedocomputers.com>");
-MODULE_VERSION("0.3.9");
+MODULE_VERSION("0.3.17");
 MODULE_LICENSE("GPL");
 
 MODULE_ALIAS_CLEVO_INTERFACES();
@@ -58,8 +69,12 @@ static int uw_get_tdp_min(u8 tdp_index);
 static int uw_get_tdp_max(u8 tdp_index);
 static int uw_get_tdp(u8 tdp_index);
 static int uw_set_tdp(u8 tdp_index, int tdp_value);
+static int uw_set_tdp_all(const s32 *tdp_values);
 static u32 uw_set_performance_profile_v1(enum uw_perf_profiles_v1 profile);
 
+static long tuxedo_io_fan_curve_upload(unsigned long arg, int num_fans);
+static void tuxedo_io_fan_curves_clear(void);
+
 /**
  * strstr version of dmi_match
  */
@@ -272,24 +287,82 @@ static u32 uniwill_identify(void)
 	return result;
 }
 
-/*static int fop_open(struct inode *inode, struct file *file)
+static int clevo_read_snapshot(struct tuxedo_io_cl_snapshot *snapshot)
 {
+	static const u8 faninfo_cmds[] = {
+		CLEVO_CMD_GET_FANINFO1,
+		CLEVO_CMD_GET_FANINFO2,
+		CLEVO_CMD_GET_FANINFO3
+	};
+	u32 result;
+	int i;
+
+	if (!id_check_clevo)
+		return -ENODEV;
+
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->version = TUXEDO_IO_CL_SNAPSHOT_VERSION;
+
+	for (i = 0; i < ARRAY_SIZE(faninfo_cmds); ++i) {
+		if (clevo_evaluate_method(faninfo_cmds[i], 0, &result) == 0) {
+			snapshot->faninfo[i] = result;
+			snapshot->valid |= TUXEDO_IO_CL_SNAPSHOT_FANINFO1 << i;
+		}
+	}
+
 	return 0;
 }
 
-static int fop_release(struct inode *inode, struct file *file)
+static long clevo_ioctl_snapshot(unsigned long arg)
 {
+	struct tuxedo_io_cl_snapshot snapshot;
+	int status;
+
+	status = clevo_read_snapshot(&snapshot);
+	if (status)
+		return status;
+
+	if (copy_to_user((void *) arg, &snapshot, sizeof(snapshot)))
+		return -EFAULT;
+
 	return 0;
-}*/
+}
+
+#ifdef DEBUG
+static long uniwill_ioctl_read(struct file *file, unsigned int cmd, unsigned long arg);
+static long uniwill_ioctl_write(struct file *file, unsigned int cmd, unsigned long arg);
+#endif
+
+/*
+ * The written duty only shows up in the fan info after a while, there is no
+ * known ready flag. Synchronous writes poll the fan info with growing
+ * intervals instead of a fixed delay and record how long it took.
+ */
+#define CLEVO_FANSPEED_SETTLE_POLL_MIN_US	2000
+#define CLEVO_FANSPEED_SETTLE_POLL_MAX_US	20000
+#define CLEVO_FANSPEED_SETTLE_TIMEOUT_MS	500
+
+static DEFINE_SPINLOCK(clevo_fan_settle_lock);
+static u32 clevo_fan_settle_us;		// Running average, 0 until first measured
+static u32 clevo_fan_settle_us_last;
+static u32 clevo_fan_settle_us_max;
 
-static long clevo_ioctl_interface(struct file *file, unsigned int cmd, unsigned long arg)
+static void clevo_fan_settle_record(u32 settle_us)
+{
+	spin_lock(&clevo_fan_settle_lock);
+	if (clevo_fan_settle_us == 0)
+		clevo_fan_settle_us = settle_us;
+	else
+		clevo_fan_settle_us = (clevo_fan_settle_us * 3 + settle_us) / 4;
+	clevo_fan_settle_us_last = settle_us;
+	clevo_fan_settle_us_max = max(clevo_fan_settle_us_max, settle_us);
+	spin_unlock(&clevo_fan_settle_lock);
+}
+
+static long clevo_ioctl_read(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	u32 result = 0, status;
 	u32 copy_result;
-	u32 argument = (u32) arg;
-	int i;
-
-	u32 clevo_arg;
 
 	const char str_no_if[] = "";
 	char *str_clevo_if;
@@ -334,36 +407,125 @@ static long clevo_ioctl_interface(struct file *file, unsigned int cmd, unsigned
 			status = clevo_evaluate_method(CLEVO_CMD_GET_TOUCHPAD_SW, 0, &result);
 			copy_result = copy_to_user((int32_t *) arg, &result, sizeof(result));
 			break;
+		case R_CL_SNAPSHOT:
+			return clevo_ioctl_snapshot(arg);
+		case R_CL_FAN_SETTLE_US:
+			spin_lock(&clevo_fan_settle_lock);
+			result = clevo_fan_settle_us;
+			spin_unlock(&clevo_fan_settle_lock);
+			copy_result = copy_to_user((int32_t *) arg, &result, sizeof(result));
+			break;
+#ifdef DEBUG
+		// Raw EC access shares the clevo read magic
+		case R_TF_BC:
+			return uniwill_ioctl_read(file, cmd, arg);
+#endif
 	}
 
+	return 0;
+}
+
+static u32 clevo_set_fanspeeds(u32 argument)
+{
+	u32 result;
+	int i;
+
+	// Don't allow vallues between fan-off and minimum fan-on-speed
+	u8 fanspeeds[3] = { argument & 0xff, argument >> 8 & 0xff, argument >> 16 & 0xff };
+	for (i = 0; i < 3; ++i) {
+		if (fanspeeds[i] < FAN_ON_MIN_SPEED_PERCENT * NB01_FAN_SPEED_MAX / 2 / 100)
+			fanspeeds[i] = 0;
+		else if (fanspeeds[i] < FAN_ON_MIN_SPEED_PERCENT * NB01_FAN_SPEED_MAX / 100)
+			fanspeeds[i] = FAN_ON_MIN_SPEED_PERCENT * NB01_FAN_SPEED_MAX / 100;
+	}
+	argument = fanspeeds[0];
+	argument |= fanspeeds[1] << 8;
+	argument |= fanspeeds[2] << 16;
+
+	clevo_evaluate_method(CLEVO_CMD_SET_FANSPEED_VALUE, argument, &result);
+
+	return argument;
+}
+
+/*
+ * The EC takes over all fans at once, so the first fan that had a different
+ * duty before and now reports the written one marks the write as settled.
+ * Fans that can't be read or never change (not present) are ignored.
+ */
+static int clevo_set_fanspeeds_sync(u32 argument)
+{
+	struct tuxedo_io_cl_snapshot before, now;
+	unsigned int delay_us = CLEVO_FANSPEED_SETTLE_POLL_MIN_US;
+	bool pending = false;
+	ktime_t start;
+	u32 duty;
+	int i, status;
+
+	status = clevo_read_snapshot(&before);
+	if (status)
+		return status;
+
+	start = ktime_get();
+	argument = clevo_set_fanspeeds(argument);
+
+	for (i = 0; i < ARRAY_SIZE(before.faninfo); ++i) {
+		duty = argument >> (i * 8) & 0xff;
+		if ((before.valid & (TUXEDO_IO_CL_SNAPSHOT_FANINFO1 << i)) &&
+		    (before.faninfo[i] & 0xff) != duty)
+			pending = true;
+	}
+	// Nothing to wait for
+	if (!pending)
+		return 0;
+
+	while (ktime_ms_delta(ktime_get(), start) < CLEVO_FANSPEED_SETTLE_TIMEOUT_MS) {
+		usleep_range(delay_us, delay_us + delay_us / 4);
+		delay_us = min(delay_us * 2, CLEVO_FANSPEED_SETTLE_POLL_MAX_US);
+
+		if (clevo_read_snapshot(&now))
+			continue;
+		for (i = 0; i < ARRAY_SIZE(now.faninfo); ++i) {
+			duty = argument >> (i * 8) & 0xff;
+			if (!(before.valid & now.valid & (TUXEDO_IO_CL_SNAPSHOT_FANINFO1 << i)))
+				continue;
+			if ((before.faninfo[i] & 0xff) != duty && (now.faninfo[i] & 0xff) == duty) {
+				clevo_fan_settle_record(ktime_us_delta(ktime_get(), start));
+				return 0;
+			}
+		}
+	}
+
+	return -ETIMEDOUT;
+}
+
+static long clevo_ioctl_write(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	u32 result = 0, status;
+	u32 copy_result;
+	u32 argument = (u32) arg;
+
+	u32 clevo_arg;
+
 	switch (cmd) {
 		case W_CL_FANSPEED:
 			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-
-			// Don't allow vallues between fan-off and minimum fan-on-speed
-			u8 fanspeeds[3] = { argument & 0xff, argument >> 8 & 0xff, argument >> 16 & 0xff };
-			for (i = 0; i < 3; ++i) {
-				if (fanspeeds[i] < FAN_ON_MIN_SPEED_PERCENT * NB01_FAN_SPEED_MAX / 2 / 100)
-					fanspeeds[i] = 0;
-				else if (fanspeeds[i] < FAN_ON_MIN_SPEED_PERCENT * NB01_FAN_SPEED_MAX / 100)
-					fanspeeds[i] = FAN_ON_MIN_SPEED_PERCENT * NB01_FAN_SPEED_MAX / 100;
-			}
-			argument = fanspeeds[0];
-			argument |= fanspeeds[1] << 8;
-			argument |= fanspeeds[2] << 16;
-
-			clevo_evaluate_method(CLEVO_CMD_SET_FANSPEED_VALUE, argument, &result);
-			// Note: Delay needed to let hardware catch up with the written value.
-			// No known ready flag. If the value is read too soon, the old value
-			// will still be read out.
-			// (Theoretically needed for other methods as well.)
-			// Can it be lower? 50ms is too low
-			msleep(100);
+			tuxedo_io_fan_curves_clear();
+			clevo_set_fanspeeds(argument);
 			break;
+		case W_CL_FANSPEED_SYNC:
+			if (copy_from_user(&argument, (int32_t *) arg, sizeof(argument)))
+				return -EFAULT;
+			tuxedo_io_fan_curves_clear();
+			return clevo_set_fanspeeds_sync(argument);
 		case W_CL_FANAUTO:
 			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
+			tuxedo_io_fan_curves_clear();
 			clevo_evaluate_method(CLEVO_CMD_SET_FANSPEED_AUTO, argument, &result);
 			break;
+		case W_CL_SW_FAN_CURVE:
+			if (!id_check_clevo)
+				return -ENODEV;
+			return tuxedo_io_fan_curve_upload(arg, 3);
 		case W_CL_WEBCAM_SW:
 			if (dmi_match(DMI_PRODUCT_SKU, "AURA14GEN3") ||
 			    dmi_match(DMI_PRODUCT_SKU, "AURA15GEN3"))
@@ -389,6 +551,10 @@ static long clevo_ioctl_interface(struct file *file, unsigned int cmd, unsigned
 			clevo_arg = (CLEVO_CMD_OPT_SUB_SET_PERF_PROF << 0x18) | (argument & 0xff);
 			clevo_evaluate_method(CLEVO_CMD_OPT, clevo_arg, &result);
 			break;
+#ifdef DEBUG
+		case W_TF_BC:
+			return uniwill_ioctl_write(file, cmd, arg);
+#endif
 	}
 
 	return 0;
@@ -482,6 +648,205 @@ static int uw_set_tdp(u8 tdp_index, int tdp_value)
 	return 0;
 }
 
+/*
+ * All TDP values validated up front and written with one bulk EC write, so
+ * there is no window with a mixed old/new PL1/PL2/PL4 combination. Values for
+ * unsupported TDP indices are ignored, their registers are not touched. An
+ * unsupported index between supported ones splits the write in two.
+ */
+static int uw_set_tdp_all(const s32 *tdp_values)
+{
+	u8 tdp_data[3];
+	bool supported[3];
+	u16 tdp_base_addr = 0x0783;
+	int i, first, status;
+	bool any = false;
+
+	for (i = 0; i < 3; ++i) {
+		supported[i] = uw_get_tdp_min(i) >= 0;
+		if (!supported[i])
+			continue;
+		if (tdp_values[i] < uw_get_tdp_min(i) || tdp_values[i] > uw_get_tdp_max(i))
+			return -EINVAL;
+		if (i == 2 && uw_feats->uniwill_has_double_pl4)
+			tdp_data[i] = tdp_values[i] / 2;
+		else
+			tdp_data[i] = tdp_values[i];
+		any = true;
+	}
+
+	if (!any)
+		return -ENODEV;
+
+	if (uw_feats->uniwill_custom_profile_mode_needed) {
+		// Ensure that "overboost" profile is chosen when using TDP set
+		// for devices that require this
+		uw_set_performance_profile_v1(PROFILE_OVERBOOST);
+	}
+
+	// One bulk write per run of supported indices
+	for (i = 0; i < 3; ++i) {
+		if (!supported[i])
+			continue;
+		first = i;
+		while (i + 1 < 3 && supported[i + 1])
+			++i;
+		status = uniwill_write_ec_ram_bulk(tdp_base_addr + first, &tdp_data[first], i - first + 1);
+		if (status)
+			return status;
+	}
+
+	return 0;
+}
+
+#if IS_ENABLED(CONFIG_POWERCAP)
+/*
+ * TDP values as powercap constraints of one zone, so standard tools can
+ * manage them. Constraint names follow intel-rapl for PL1, PL2 and PL4.
+ * Limits and double PL4 handling are the same as for the ioctls.
+ */
+static const char * const uw_powercap_constraint_names[] = {
+	"long_term", "short_term", "peak_power"
+};
+
+static struct powercap_control_type *uw_powercap_control_type;
+static struct powercap_zone uw_powercap_zone;
+static bool uw_powercap_zone_registered;
+static int uw_powercap_tdp_index[3];
+
+static int uw_powercap_get_max_power_range_uw(struct powercap_zone *zone, u64 *max_power_uw)
+{
+	int i, tdp_max = 0;
+
+	for (i = 0; i < 3; ++i)
+		tdp_max = max(tdp_max, uw_get_tdp_max(i));
+	*max_power_uw = (u64)tdp_max * 1000000;
+
+	return 0;
+}
+
+static int uw_powercap_get_power_uw(struct powercap_zone *zone, u64 *power_uw)
+{
+	// Required by the powercap core, the EC doesn't report the actual power
+	return -ENODATA;
+}
+
+static const struct powercap_zone_ops uw_powercap_zone_ops = {
+	.get_max_power_range_uw = uw_powercap_get_max_power_range_uw,
+	.get_power_uw = uw_powercap_get_power_uw,
+};
+
+static int uw_powercap_set_power_limit_uw(struct powercap_zone *zone, int cid, u64 power_limit_uw)
+{
+	u64 tdp_value = div_u64(power_limit_uw, 1000000);
+
+	if (tdp_value > INT_MAX)
+		return -EINVAL;
+
+	return uw_set_tdp(uw_powercap_tdp_index[cid], tdp_value);
+}
+
+static int uw_powercap_get_power_limit_uw(struct powercap_zone *zone, int cid, u64 *power_limit_uw)
+{
+	int tdp_value = uw_get_tdp(uw_powercap_tdp_index[cid]);
+
+	if (tdp_value < 0)
+		return tdp_value;
+	*power_limit_uw = (u64)tdp_value * 1000000;
+
+	return 0;
+}
+
+static int uw_powercap_set_time_window_us(struct powercap_zone *zone, int cid, u64 time_window_us)
+{
+	return -EOPNOTSUPP;
+}
+
+static int uw_powercap_get_time_window_us(struct powercap_zone *zone, int cid, u64 *time_window_us)
+{
+	// Time windows are fixed in the EC firmware and not known
+	*time_window_us = 0;
+
+	return 0;
+}
+
+static int uw_powercap_get_max_power_uw(struct powercap_zone *zone, int cid, u64 *max_power_uw)
+{
+	*max_power_uw = (u64)uw_get_tdp_max(uw_powercap_tdp_index[cid]) * 1000000;
+
+	return 0;
+}
+
+static int uw_powercap_get_min_power_uw(struct powercap_zone *zone, int cid, u64 *min_power_uw)
+{
+	*min_power_uw = (u64)uw_get_tdp_min(uw_powercap_tdp_index[cid]) * 1000000;
+
+	return 0;
+}
+
+static const char *uw_powercap_get_name(struct powercap_zone *zone, int cid)
+{
+	return uw_powercap_constraint_names[uw_powercap_tdp_index[cid]];
+}
+
+static const struct powercap_zone_constraint_ops uw_powercap_constraint_ops = {
+	.set_power_limit_uw = uw_powercap_set_power_limit_uw,
+	.get_power_limit_uw = uw_powercap_get_power_limit_uw,
+	.set_time_window_us = uw_powercap_set_time_window_us,
+	.get_time_window_us = uw_powercap_get_time_window_us,
+	.get_max_power_uw = uw_powercap_get_max_power_uw,
+	.get_min_power_uw = uw_powercap_get_min_power_uw,
+	.get_name = uw_powercap_get_name,
+};
+
+static void uw_powercap_init(void)
+{
+	struct powercap_zone *zone;
+	int i, nr_constraints = 0;
+
+	if (!id_check_uniwill || !uw_feats)
+		return;
+
+	for (i = 0; i < 3; ++i) {
+		if (uw_get_tdp_min(i) >= 0)
+			uw_powercap_tdp_index[nr_constraints++] = i;
+	}
+	if (nr_constraints == 0)
+		return;
+
+	uw_powercap_control_type = powercap_register_control_type(NULL, "tuxedo-uniwill", NULL);
+	if (IS_ERR(uw_powercap_control_type)) {
+		pr_err("Failed to register powercap control type\n");
+		uw_powercap_control_type = NULL;
+		return;
+	}
+
+	zone = powercap_register_zone(&uw_powercap_zone, uw_powercap_control_type, "package",
+				      NULL, &uw_powercap_zone_ops, nr_constraints,
+				      &uw_powercap_constraint_ops);
+	if (IS_ERR(zone)) {
+		pr_err("Failed to register powercap zone\n");
+		powercap_unregister_control_type(uw_powercap_control_type);
+		uw_powercap_control_type = NULL;
+		return;
+	}
+	uw_powercap_zone_registered = true;
+}
+
+static void uw_powercap_remove(void)
+{
+	if (uw_powercap_zone_registered)
+		powercap_unregister_zone(uw_powercap_control_type, &uw_powercap_zone);
+	if (uw_powercap_control_type)
+		powercap_unregister_control_type(uw_powercap_control_type);
+	uw_powercap_zone_registered = false;
+	uw_powercap_control_type = NULL;
+}
+#else
+static void uw_powercap_init(void) { }
+static void uw_powercap_remove(void) { }
+#endif
+
 /**
  * Set profile 1-3 to 0xa0, 0x00 or 0x10 depending on
  * device support.
@@ -517,18 +882,82 @@ static u32 uw_set_performance_profile_v1(enum uw_perf_profiles_v1 profile)
 	return result;
 }
 
-static long uniwill_ioctl_interface(struct file *file, unsigned int cmd, unsigned long arg)
+/*
+ * Addresses read for R_UW_SNAPSHOT, all in one multi read
+ */
+static const u16 uw_snapshot_addresses[] = {
+	0x1804, 0x1809,		// Fan speeds
+	0x043e, 0x044f,		// Fan temperatures
+	0x0751, 0x0741,		// Mode, mode enable
+	0x0783, 0x0784, 0x0785	// TDP 0 - 2
+};
+
+static int uniwill_read_snapshot(struct tuxedo_io_uw_snapshot *snapshot)
+{
+	u8 data[ARRAY_SIZE(uw_snapshot_addresses)];
+	int i, status;
+
+	if (!id_check_uniwill || !uw_feats)
+		return -ENODEV;
+
+	status = uniwill_read_ec_ram_multi(uw_snapshot_addresses, data, ARRAY_SIZE(data));
+	if (status)
+		return status;
+
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->version = TUXEDO_IO_UW_SNAPSHOT_VERSION;
+
+	for (i = 0; i < 2; ++i) {
+		snapshot->fanspeed[i] = data[i];
+		if (uw_feats->uniwill_has_universal_ec_fan_control && data[i] == 1)
+			snapshot->fanspeed[i] = 0; // 1 is 0 behaviour see: uw_set_fan
+		snapshot->fan_temp[i] = data[2 + i];
+	}
+	snapshot->valid |= TUXEDO_IO_UW_SNAPSHOT_FANSPEED | TUXEDO_IO_UW_SNAPSHOT_FAN_TEMP;
+
+	snapshot->mode = data[4];
+	snapshot->mode_enable = data[5];
+	snapshot->valid |= TUXEDO_IO_UW_SNAPSHOT_MODE;
+
+	for (i = 0; i < 3; ++i) {
+		// Same support detection as uw_get_tdp()
+		if (uw_get_tdp_min(i) < 0)
+			continue;
+		if (i == 2 && uw_feats->uniwill_has_double_pl4)
+			snapshot->tdp[i] = (int)data[6 + i] * 2;
+		else
+			snapshot->tdp[i] = data[6 + i];
+		snapshot->valid |= TUXEDO_IO_UW_SNAPSHOT_TDP0 << i;
+	}
+
+	return 0;
+}
+
+static long uniwill_ioctl_snapshot(unsigned long arg)
+{
+	struct tuxedo_io_uw_snapshot snapshot;
+	int status;
+
+	status = uniwill_read_snapshot(&snapshot);
+	if (status)
+		return status;
+
+	if (copy_to_user((void *) arg, &snapshot, sizeof(snapshot)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static long uniwill_ioctl_read(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	u32 result = 0;
 	u32 copy_result;
-	u32 argument;
 	u8 byte_data;
 	const char str_no_if[] = "";
 	char *str_uniwill_if;
 
 #ifdef DEBUG
 	union uw_ec_read_return reg_read_return;
-	union uw_ec_write_return reg_write_return;
 	u32 uw_arg[10];
 	u32 uw_result[10];
 	int i;
@@ -665,14 +1094,34 @@ static long uniwill_ioctl_interface(struct file *file, unsigned int cmd, unsigne
 			}*/
 			break;
 #endif
+		case R_UW_SNAPSHOT:
+			return uniwill_ioctl_snapshot(arg);
 	}
 
+	return 0;
+}
+
+static long uniwill_ioctl_write(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	u32 copy_result;
+	u32 argument;
+	struct tuxedo_io_uw_fan_curve fan_curve_arg;
+	struct uniwill_fan_curve_t fan_curve;
+	struct tuxedo_io_uw_tdp_all tdp_all_arg;
+	int status;
+
+#ifdef DEBUG
+	union uw_ec_write_return reg_write_return;
+	u32 uw_arg[10];
+#endif
+
 	switch (cmd) {
 		case W_UW_FANSPEED:
 		case W_UW_FANSPEED2:
 			// Get fan speed argument
 			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
 			u8 fan_select = (cmd == W_UW_FANSPEED2);
+			tuxedo_io_fan_curves_clear();
 			uw_set_fan(fan_select, argument);
 			break;
 		case W_UW_MODE:
@@ -687,6 +1136,7 @@ static long uniwill_ioctl_interface(struct file *file, unsigned int cmd, unsigne
 			*/
 			break;
 		case W_UW_FANAUTO:
+			tuxedo_io_fan_curves_clear();
 			uw_set_fan_auto();
 			break;
 		case W_UW_TDP0:
@@ -701,10 +1151,33 @@ static long uniwill_ioctl_interface(struct file *file, unsigned int cmd, unsigne
 			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
 			uw_set_tdp(2, argument);
 			break;
+		case W_UW_TDP_ALL:
+			if (copy_from_user(&tdp_all_arg, (void *) arg, sizeof(tdp_all_arg)))
+				return -EFAULT;
+			return uw_set_tdp_all(tdp_all_arg.tdp);
 		case W_UW_PERF_PROF:
 			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
 			uw_set_performance_profile_v1(argument);
 			break;
+		case W_UW_FAN_CURVE:
+			BUILD_BUG_ON(sizeof(fan_curve_arg.temp) != sizeof(fan_curve.temp));
+			BUILD_BUG_ON(sizeof(fan_curve_arg.speed) != sizeof(fan_curve.speed));
+			if (copy_from_user(&fan_curve_arg, (void *) arg, sizeof(fan_curve_arg)))
+				return -EFAULT;
+			if (fan_curve_arg.num_points < 1 || fan_curve_arg.num_points > UW_FAN_CURVE_MAX_POINTS)
+				return -EINVAL;
+			fan_curve.num_points = fan_curve_arg.num_points;
+			memcpy(fan_curve.temp, fan_curve_arg.temp, sizeof(fan_curve.temp));
+			memcpy(fan_curve.speed, fan_curve_arg.speed, sizeof(fan_curve.speed));
+			tuxedo_io_fan_curves_clear();
+			status = uw_set_fan_curve(fan_curve_arg.fan_index, &fan_curve);
+			if (status)
+				return status;
+			break;
+		case W_UW_SW_FAN_CURVE:
+			if (!id_check_uniwill)
+				return -ENODEV;
+			return tuxedo_io_fan_curve_upload(arg, 2);
 #ifdef DEBUG
 		case W_TF_BC:
 			reg_write_return.dword = 0;
@@ -730,11 +1203,62 @@ static long uniwill_ioctl_interface(struct file *file, unsigned int cmd, unsigne
 	return 0;
 }
 
-static long fop_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+static struct tuxedo_io_capabilities tuxedo_io_caps;
+static DEFINE_MUTEX(tuxedo_io_caps_lock);
+
+static void tuxedo_io_caps_update(void)
+{
+	struct tuxedo_io_capabilities caps;
+	int i;
+
+	memset(&caps, 0, sizeof(caps));
+	caps.version = TUXEDO_IO_CAPABILITIES_VERSION;
+	for (i = 0; i < 3; ++i) {
+		caps.tdp_min[i] = -ENODEV;
+		caps.tdp_max[i] = -ENODEV;
+	}
+
+	if (id_check_clevo) {
+		caps.flags |= TUXEDO_IO_CAP_CLEVO;
+		// Same exclusions as R_CL_WEBCAM_SW
+		if (!dmi_match(DMI_PRODUCT_SKU, "AURA14GEN3") &&
+		    !dmi_match(DMI_PRODUCT_SKU, "AURA15GEN3") &&
+		    !dmi_match(DMI_PRODUCT_SKU, "AURA14GEN4 / AURA15GEN4"))
+			caps.flags |= TUXEDO_IO_CAP_CL_WEBCAM_SW;
+	}
+
+	if (id_check_uniwill && uw_feats) {
+		caps.flags |= TUXEDO_IO_CAP_UNIWILL | TUXEDO_IO_CAP_UW_FANS_OFF;
+		if (uw_feats->uniwill_has_universal_ec_fan_control)
+			caps.flags |= TUXEDO_IO_CAP_UW_EC_FAN_CURVE;
+		if (uw_feats->uniwill_custom_profile_mode_needed)
+			caps.flags |= TUXEDO_IO_CAP_UW_CUSTOM_PROFILE_MODE;
+
+		caps.uw_model = uw_feats->model;
+		if (uw_feats->uniwill_profile_v1_two_profs)
+			caps.uw_profs_available = 2;
+		else if (uw_feats->uniwill_profile_v1_three_profs || uw_feats->uniwill_profile_v1_three_profs_leds_only)
+			caps.uw_profs_available = 3;
+		caps.fans_min_speed = FAN_ON_MIN_SPEED_PERCENT;
+
+		for (i = 0; i < 3; ++i) {
+			caps.tdp_min[i] = uw_get_tdp_min(i);
+			caps.tdp_max[i] = uw_get_tdp_max(i);
+			if (caps.tdp_min[i] >= 0)
+				caps.flags |= TUXEDO_IO_CAP_UW_TDP0 << i;
+		}
+	}
+
+	mutex_lock(&tuxedo_io_caps_lock);
+	tuxedo_io_caps = caps;
+	mutex_unlock(&tuxedo_io_caps_lock);
+}
+
+static long general_ioctl_interface(struct file *file, unsigned int cmd, unsigned long arg)
 {
-	u32 status;
-	// u32 result = 0;
+	struct tuxedo_io_capabilities caps;
 	u32 copy_result;
+	u32 id_check;
 
 	const char *module_version = THIS_MODULE->version;
 	switch (cmd) {
@@ -743,28 +1267,683 @@ static long fop_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		// Hardware id checks, 1 = positive, 0 = negative
 		case R_HWCHECK_CL:
-			id_check_clevo = clevo_identify();
+			id_check = clevo_identify();
+			if (id_check != id_check_clevo) {
+				id_check_clevo = id_check;
+				tuxedo_io_caps_update();
+			}
 			copy_result = copy_to_user((void *) arg, (void *) &id_check_clevo, sizeof(id_check_clevo));
 			break;
 		case R_HWCHECK_UW:
-			id_check_uniwill = uniwill_identify();
+			id_check = uniwill_identify();
+			if (id_check != id_check_uniwill) {
+				id_check_uniwill = id_check;
+				tuxedo_io_caps_update();
+			}
 			copy_result = copy_to_user((void *) arg, (void *) &id_check_uniwill, sizeof(id_check_uniwill));
 			break;
+		case R_CAPABILITIES:
+			mutex_lock(&tuxedo_io_caps_lock);
+			caps = tuxedo_io_caps;
+			mutex_unlock(&tuxedo_io_caps_lock);
+			if (copy_to_user((void *) arg, &caps, sizeof(caps)))
+				return -EFAULT;
+			break;
+	}
+
+	return 0;
+}
+
+typedef long (tuxedo_io_ioctl_handler_t)(struct file *file, unsigned int cmd, unsigned long arg);
+
+/*
+ * Each ioctl magic belongs to exactly one interface, index is
+ * _IOC_TYPE(cmd) - IOCTL_MAGIC
+ */
+static tuxedo_io_ioctl_handler_t *tuxedo_io_ioctl_handlers[] = {
+	[IOCTL_MAGIC - IOCTL_MAGIC]	= general_ioctl_interface,
+	[MAGIC_READ_CL - IOCTL_MAGIC]	= clevo_ioctl_read,
+	[MAGIC_WRITE_CL - IOCTL_MAGIC]	= clevo_ioctl_write,
+	[MAGIC_READ_UW - IOCTL_MAGIC]	= uniwill_ioctl_read,
+	[MAGIC_WRITE_UW - IOCTL_MAGIC]	= uniwill_ioctl_write,
+};
+
+#define TUXEDO_IO_IOCTL_TYPES	ARRAY_SIZE(tuxedo_io_ioctl_handlers)
+#define TUXEDO_IO_IOCTL_NRS	(_IOC_NRMASK + 1)
+
+struct tuxedo_io_ioctl_stat_t {
+	atomic64_t calls;
+	atomic64_t errors;
+	atomic64_t total_ns;
+};
+
+static struct tuxedo_io_ioctl_stat_t tuxedo_io_ioctl_stats[TUXEDO_IO_IOCTL_TYPES][TUXEDO_IO_IOCTL_NRS];
+
+static long fop_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	unsigned int type = _IOC_TYPE(cmd) - IOCTL_MAGIC;
+	struct tuxedo_io_ioctl_stat_t *stat;
+	u64 start;
+	long status;
+
+	if (type >= TUXEDO_IO_IOCTL_TYPES)
+		return -ENOTTY;
+
+	stat = &tuxedo_io_ioctl_stats[type][_IOC_NR(cmd)];
+
+	start = ktime_get_ns();
+	status = tuxedo_io_ioctl_handlers[type](file, cmd, arg);
+	atomic64_add(ktime_get_ns() - start, &stat->total_ns);
+	atomic64_inc(&stat->calls);
+	if (status)
+		atomic64_inc(&stat->errors);
+
+	return status;
+}
+
+static int tuxedo_io_ioctl_stats_show(struct seq_file *m, void *v)
+{
+	struct tuxedo_io_ioctl_stat_t *stat;
+	s64 calls, total_ns;
+	int type, nr;
+
+	seq_puts(m, "magic nr calls errors total_ns avg_ns\n");
+	for (type = 0; type < TUXEDO_IO_IOCTL_TYPES; ++type) {
+		for (nr = 0; nr < TUXEDO_IO_IOCTL_NRS; ++nr) {
+			stat = &tuxedo_io_ioctl_stats[type][nr];
+			calls = atomic64_read(&stat->calls);
+			if (calls == 0)
+				continue;
+			total_ns = atomic64_read(&stat->total_ns);
+			seq_printf(m, "0x%02x 0x%02x %lld %lld %lld %lld\n",
+				   IOCTL_MAGIC + type, nr, calls,
+				   atomic64_read(&stat->errors), total_ns,
+				   div64_s64(total_ns, calls));
+		}
+	}
+
+	return 0;
+}
+
+static int tuxedo_io_ioctl_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tuxedo_io_ioctl_stats_show, NULL);
+}
+
+/*
+ * Any write resets the counters
+ */
+static ssize_t tuxedo_io_ioctl_stats_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct tuxedo_io_ioctl_stat_t *stat;
+	int type, nr;
+
+	for (type = 0; type < TUXEDO_IO_IOCTL_TYPES; ++type) {
+		for (nr = 0; nr < TUXEDO_IO_IOCTL_NRS; ++nr) {
+			stat = &tuxedo_io_ioctl_stats[type][nr];
+			atomic64_set(&stat->calls, 0);
+			atomic64_set(&stat->errors, 0);
+			atomic64_set(&stat->total_ns, 0);
+		}
+	}
+
+	return count;
+}
+
+static const struct file_operations tuxedo_io_ioctl_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = tuxedo_io_ioctl_stats_open,
+	.read = seq_read,
+	.write = tuxedo_io_ioctl_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *tuxedo_io_debugfs_dir;
+
+/*
+ * Event delivery through read()/poll(). Every open file gets its own record
+ * queue, producers are the interface event notifiers (atomic context) and the
+ * sampler work. The sampler only runs while at least one open file has used
+ * read(), poll() or mmap(), plain ioctl clients cause no sampling.
+ */
+#define TUXEDO_IO_EVENT_QUEUE_LEN	64
+#define TUXEDO_IO_EVENT_READ_BATCH	16
+
+static unsigned int sample_interval_ms = 1000;
+module_param(sample_interval_ms, uint, 0644);
+MODULE_PARM_DESC(sample_interval_ms, "Sampling interval for read()/poll() events, the mmap() telemetry page and kernel fan curves in ms (min 100)");
+
+static unsigned int event_temp_step = 5;
+module_param(event_temp_step, uint, 0644);
+MODULE_PARM_DESC(event_temp_step, "Temperature step in °C that triggers a temperature event");
+
+struct tuxedo_io_file_t {
+	struct list_head list;
+	DECLARE_KFIFO(events, struct tuxedo_io_event, TUXEDO_IO_EVENT_QUEUE_LEN);
+	u32 lost;
+	bool sampling;
+};
+
+static LIST_HEAD(tuxedo_io_files);
+// Protects tuxedo_io_files and the per file queues
+static DEFINE_SPINLOCK(tuxedo_io_files_lock);
+// Serializes sampler start/stop
+static DEFINE_MUTEX(tuxedo_io_files_mutex);
+static unsigned int tuxedo_io_sampling_files;
+static DECLARE_WAIT_QUEUE_HEAD(tuxedo_io_event_wait);
+
+static void tuxedo_io_event_push(u32 type, u32 index, s32 value)
+{
+	struct tuxedo_io_event event = {
+		.type = type,
+		.index = index,
+		.value = value,
+		.timestamp_ns = ktime_get_ns(),
+	};
+	struct tuxedo_io_file_t *io_file;
+	struct tuxedo_io_event dropped;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tuxedo_io_files_lock, flags);
+	list_for_each_entry(io_file, &tuxedo_io_files, list) {
+		if (kfifo_is_full(&io_file->events)) {
+			if (kfifo_get(&io_file->events, &dropped))
+				io_file->lost++;
+		}
+		kfifo_put(&io_file->events, event);
+	}
+	spin_unlock_irqrestore(&tuxedo_io_files_lock, flags);
+
+	wake_up_interruptible(&tuxedo_io_event_wait);
+}
+
+static int clevo_event_notify(struct notifier_block *nb, unsigned long action, void *data)
+{
+	tuxedo_io_event_push(TUXEDO_IO_EVENT_HW, 0, action);
+
+	return NOTIFY_DONE;
+}
+
+static int uniwill_event_notify(struct notifier_block *nb, unsigned long action, void *data)
+{
+	if (action == UNIWILL_OSD_DC_ADAPTER_CHANGE)
+		tuxedo_io_event_push(TUXEDO_IO_EVENT_AC_ADAPTER, 0, 0);
+	tuxedo_io_event_push(TUXEDO_IO_EVENT_HW, 0, action);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block clevo_event_nb = {
+	.notifier_call = clevo_event_notify,
+};
+
+static struct notifier_block uniwill_event_nb = {
+	.notifier_call = uniwill_event_notify,
+};
+
+/*
+ * Last sampled values, only touched by the sampler. Cleared whenever the
+ * sampler is started so the first run only sets the baseline.
+ */
+static struct {
+	bool primed;
+	int fanspeed[3];
+	int temp_step[3];
+	int mode;
+} tuxedo_io_sample;
+
+// Read-only page shared with userspace through mmap(), see tuxedo_io_ioctl.h
+static struct tuxedo_io_telemetry *tuxedo_io_telemetry;
+
+static void tuxedo_io_telemetry_publish(const struct tuxedo_io_telemetry *telemetry)
+{
+	const size_t offset = offsetof(struct tuxedo_io_telemetry, version);
+	u32 seq = tuxedo_io_telemetry->seq;
+
+	// Single writer (the sampler), odd sequence while the page is updated
+	WRITE_ONCE(tuxedo_io_telemetry->seq, seq + 1);
+	smp_wmb();
+	memcpy((u8 *)tuxedo_io_telemetry + offset, (const u8 *)telemetry + offset,
+	       sizeof(*telemetry) - offset);
+	smp_wmb();
+	WRITE_ONCE(tuxedo_io_telemetry->seq, seq + 2);
+}
+
+static void tuxedo_io_sample_fan(struct tuxedo_io_telemetry *telemetry, int fan, int speed, int temp)
+{
+	unsigned int step = max(event_temp_step, 1U);
+
+	if (tuxedo_io_sample.primed && tuxedo_io_sample.fanspeed[fan] != speed)
+		tuxedo_io_event_push(TUXEDO_IO_EVENT_FAN_SPEED, fan, speed);
+	if (tuxedo_io_sample.primed && tuxedo_io_sample.temp_step[fan] != temp / step)
+		tuxedo_io_event_push(TUXEDO_IO_EVENT_TEMP, fan, temp);
+
+	tuxedo_io_sample.fanspeed[fan] = speed;
+	tuxedo_io_sample.temp_step[fan] = temp / step;
+
+	telemetry->fanspeed[fan] = speed;
+	telemetry->fan_temp[fan] = temp;
+	telemetry->valid |= TUXEDO_IO_TELEMETRY_FAN0 << fan;
+}
+
+static void tuxedo_io_sample_mode(struct tuxedo_io_telemetry *telemetry, int mode)
+{
+	if (tuxedo_io_sample.primed && tuxedo_io_sample.mode != mode)
+		tuxedo_io_event_push(TUXEDO_IO_EVENT_PROFILE, 0, mode);
+	tuxedo_io_sample.mode = mode;
+
+	telemetry->mode = mode;
+	telemetry->valid |= TUXEDO_IO_TELEMETRY_MODE;
+}
+
+static void tuxedo_io_sample_clevo(struct tuxedo_io_telemetry *telemetry)
+{
+	struct tuxedo_io_cl_snapshot snapshot;
+	int i;
+
+	if (clevo_read_snapshot(&snapshot))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(snapshot.faninfo); ++i) {
+		if (!(snapshot.valid & (TUXEDO_IO_CL_SNAPSHOT_FANINFO1 << i)))
+			continue;
+		// Duty in the lowest byte, temperature in the third
+		tuxedo_io_sample_fan(telemetry, i, snapshot.faninfo[i] & 0xff,
+				     (snapshot.faninfo[i] >> 16) & 0xff);
+	}
+}
+
+static void tuxedo_io_sample_uniwill(struct tuxedo_io_telemetry *telemetry)
+{
+	struct tuxedo_io_uw_snapshot snapshot;
+	int i;
+
+	if (uniwill_read_snapshot(&snapshot))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(snapshot.fanspeed); ++i)
+		tuxedo_io_sample_fan(telemetry, i, snapshot.fanspeed[i], snapshot.fan_temp[i]);
+
+	tuxedo_io_sample_mode(telemetry, snapshot.mode);
+
+	for (i = 0; i < ARRAY_SIZE(snapshot.tdp); ++i) {
+		if (!(snapshot.valid & (TUXEDO_IO_UW_SNAPSHOT_TDP0 << i)))
+			continue;
+		telemetry->tdp[i] = snapshot.tdp[i];
+		telemetry->valid |= TUXEDO_IO_TELEMETRY_TDP0 << i;
+	}
+}
+
+static void tuxedo_io_sample_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(tuxedo_io_sample_work, tuxedo_io_sample_work_fn);
+
+static void tuxedo_io_sample_work_fn(struct work_struct *work)
+{
+	struct tuxedo_io_telemetry telemetry;
+	unsigned int interval_ms = max(sample_interval_ms, 100U);
+
+	memset(&telemetry, 0, sizeof(telemetry));
+	telemetry.version = TUXEDO_IO_TELEMETRY_VERSION;
+	telemetry.interval_ms = interval_ms;
+
+	if (id_check_clevo)
+		tuxedo_io_sample_clevo(&telemetry);
+	else if (id_check_uniwill)
+		tuxedo_io_sample_uniwill(&telemetry);
+	tuxedo_io_sample.primed = true;
+
+	telemetry.timestamp_ns = ktime_get_ns();
+	tuxedo_io_telemetry_publish(&telemetry);
+
+	schedule_delayed_work(&tuxedo_io_sample_work, msecs_to_jiffies(interval_ms));
+}
+
+/*
+ * Kernel side fan curves for devices without EC curve tables. Evaluated
+ * every sample_interval_ms independent of open files, so the fans keep
+ * following the curve while the daemon is stopped or restarting. Any manual
+ * fan write or fan auto from userspace drops all curves.
+ */
+struct tuxedo_io_fan_curve_state_t {
+	struct tuxedo_io_fan_curve curve;
+	bool active;
+	int duty;			// Last applied duty in percent, -1 if none yet
+	unsigned long last_change;	// jiffies
+};
+
+static struct tuxedo_io_fan_curve_state_t tuxedo_io_fan_curves[3];
+static DEFINE_MUTEX(tuxedo_io_fan_curve_lock);
+
+static void tuxedo_io_fan_curve_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(tuxedo_io_fan_curve_work, tuxedo_io_fan_curve_work_fn);
+
+static int tuxedo_io_fan_curve_duty(const struct tuxedo_io_fan_curve *curve, int temp)
+{
+	int i, duty = curve->duty[0];
+
+	for (i = 1; i < curve->num_points; ++i) {
+		if (temp < curve->temp[i])
+			break;
+		duty = curve->duty[i];
 	}
 
-	status = clevo_ioctl_interface(file, cmd, arg);
-	if (status != 0) return status;
-	status = uniwill_ioctl_interface(file, cmd, arg);
-	if (status != 0) return status;
+	return duty;
+}
+
+/*
+ * Next duty for a fan, rising duty follows the curve directly, falling duty
+ * only once the temperature dropped hysteresis below the lower point
+ */
+static int tuxedo_io_fan_curve_next(struct tuxedo_io_fan_curve_state_t *state, int temp)
+{
+	int up = tuxedo_io_fan_curve_duty(&state->curve, temp);
+	int down = tuxedo_io_fan_curve_duty(&state->curve, temp + state->curve.hysteresis);
+
+	if (state->duty < 0 || up > state->duty)
+		return up;
+	if (down < state->duty)
+		return down;
+
+	return state->duty;
+}
+
+static bool tuxedo_io_fan_curve_step(struct tuxedo_io_fan_curve_state_t *state, int temp)
+{
+	int duty = tuxedo_io_fan_curve_next(state, temp);
+
+	if (duty == state->duty)
+		return false;
+	if (state->duty >= 0 &&
+	    time_before(jiffies, state->last_change + msecs_to_jiffies(state->curve.min_interval_ms)))
+		return false;
+
+	state->duty = duty;
+	state->last_change = jiffies;
+
+	return true;
+}
+
+static void tuxedo_io_fan_curve_clevo(void)
+{
+	struct tuxedo_io_cl_snapshot snapshot;
+	struct tuxedo_io_fan_curve_state_t *state;
+	u32 argument = 0, duty;
+	bool changed = false;
+	int i;
+
+	if (clevo_read_snapshot(&snapshot))
+		return;
+
+	/*
+	 * All fans are set at once, which takes every one of them out of
+	 * firmware auto control. Only do that once each present fan has a
+	 * curve, otherwise leave all fans untouched.
+	 */
+	for (i = 0; i < ARRAY_SIZE(snapshot.faninfo); ++i)
+		if ((snapshot.valid & (TUXEDO_IO_CL_SNAPSHOT_FANINFO1 << i)) &&
+		    !tuxedo_io_fan_curves[i].active)
+			return;
+
+	for (i = 0; i < ARRAY_SIZE(snapshot.faninfo); ++i) {
+		state = &tuxedo_io_fan_curves[i];
+		duty = snapshot.faninfo[i] & 0xff;
+		if (state->active && (snapshot.valid & (TUXEDO_IO_CL_SNAPSHOT_FANINFO1 << i))) {
+			changed |= tuxedo_io_fan_curve_step(state, (snapshot.faninfo[i] >> 16) & 0xff);
+			if (state->duty >= 0)
+				duty = state->duty * NB01_FAN_SPEED_MAX / 100;
+		}
+		argument |= duty << (i * 8);
+	}
+
+	if (changed)
+		clevo_set_fanspeeds(argument);
+}
+
+static void tuxedo_io_fan_curve_uniwill(void)
+{
+	struct tuxedo_io_uw_snapshot snapshot;
+	struct tuxedo_io_fan_curve_state_t *state;
+	int i;
+
+	if (uniwill_read_snapshot(&snapshot))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(snapshot.fan_temp); ++i) {
+		state = &tuxedo_io_fan_curves[i];
+		if (state->active && tuxedo_io_fan_curve_step(state, snapshot.fan_temp[i]))
+			uw_set_fan(i, state->duty * NB02_FAN_SPEED_MAX / 100);
+	}
+}
+
+static bool tuxedo_io_fan_curves_active(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tuxedo_io_fan_curves); ++i)
+		if (tuxedo_io_fan_curves[i].active)
+			return true;
+
+	return false;
+}
+
+static void tuxedo_io_fan_curve_work_fn(struct work_struct *work)
+{
+	mutex_lock(&tuxedo_io_fan_curve_lock);
+	if (!tuxedo_io_fan_curves_active()) {
+		mutex_unlock(&tuxedo_io_fan_curve_lock);
+		return;
+	}
+
+	if (id_check_clevo)
+		tuxedo_io_fan_curve_clevo();
+	else if (id_check_uniwill)
+		tuxedo_io_fan_curve_uniwill();
+	mutex_unlock(&tuxedo_io_fan_curve_lock);
+
+	schedule_delayed_work(&tuxedo_io_fan_curve_work,
+			      msecs_to_jiffies(max(sample_interval_ms, 100U)));
+}
+
+static long tuxedo_io_fan_curve_upload(unsigned long arg, int num_fans)
+{
+	struct tuxedo_io_fan_curve curve;
+	struct tuxedo_io_fan_curve_state_t *state;
+	bool active;
+	int i;
+
+	if (copy_from_user(&curve, (void *) arg, sizeof(curve)))
+		return -EFAULT;
+
+	if (curve.fan_index < 0 || curve.fan_index >= num_fans)
+		return -EINVAL;
+	if (curve.num_points < 0 || curve.num_points > TUXEDO_IO_FAN_CURVE_MAX_POINTS)
+		return -EINVAL;
+	if (curve.hysteresis < 0 || curve.hysteresis > TUXEDO_IO_FAN_CURVE_MAX_HYSTERESIS ||
+	    curve.min_interval_ms < 0)
+		return -EINVAL;
+	for (i = 0; i < curve.num_points; ++i) {
+		if (curve.duty[i] > 100)
+			return -EINVAL;
+		if (i > 0 && curve.temp[i] <= curve.temp[i - 1])
+			return -EINVAL;
+	}
+
+	active = curve.num_points > 0;
+
+	mutex_lock(&tuxedo_io_fan_curve_lock);
+	state = &tuxedo_io_fan_curves[curve.fan_index];
+	state->curve = curve;
+	state->active = active;
+	state->duty = -1;
+	mutex_unlock(&tuxedo_io_fan_curve_lock);
+
+	if (active)
+		mod_delayed_work(system_wq, &tuxedo_io_fan_curve_work, 0);
+
+	return 0;
+}
+
+static void tuxedo_io_fan_curves_clear(void)
+{
+	int i;
+
+	mutex_lock(&tuxedo_io_fan_curve_lock);
+	for (i = 0; i < ARRAY_SIZE(tuxedo_io_fan_curves); ++i)
+		tuxedo_io_fan_curves[i].active = false;
+	mutex_unlock(&tuxedo_io_fan_curve_lock);
+}
+
+/*
+ * Start the sampler on the first read(), poll() or mmap() of a file, it keeps
+ * running until the last file that did so is released
+ */
+static void tuxedo_io_sampler_get(struct tuxedo_io_file_t *io_file)
+{
+	if (READ_ONCE(io_file->sampling))
+		return;
+
+	mutex_lock(&tuxedo_io_files_mutex);
+	if (!io_file->sampling) {
+		WRITE_ONCE(io_file->sampling, true);
+		if (tuxedo_io_sampling_files++ == 0) {
+			memset(&tuxedo_io_sample, 0, sizeof(tuxedo_io_sample));
+			schedule_delayed_work(&tuxedo_io_sample_work, 0);
+		}
+	}
+	mutex_unlock(&tuxedo_io_files_mutex);
+}
+
+static void tuxedo_io_sampler_put(struct tuxedo_io_file_t *io_file)
+{
+	mutex_lock(&tuxedo_io_files_mutex);
+	if (io_file->sampling && --tuxedo_io_sampling_files == 0)
+		cancel_delayed_work_sync(&tuxedo_io_sample_work);
+	mutex_unlock(&tuxedo_io_files_mutex);
+}
+
+static int fop_open(struct inode *inode, struct file *file)
+{
+	struct tuxedo_io_file_t *io_file;
+
+	io_file = kzalloc(sizeof(*io_file), GFP_KERNEL);
+	if (!io_file)
+		return -ENOMEM;
+	INIT_KFIFO(io_file->events);
+	file->private_data = io_file;
+
+	spin_lock_irq(&tuxedo_io_files_lock);
+	list_add_tail(&io_file->list, &tuxedo_io_files);
+	spin_unlock_irq(&tuxedo_io_files_lock);
+
+	return nonseekable_open(inode, file);
+}
+
+static int fop_release(struct inode *inode, struct file *file)
+{
+	struct tuxedo_io_file_t *io_file = file->private_data;
+
+	spin_lock_irq(&tuxedo_io_files_lock);
+	list_del(&io_file->list);
+	spin_unlock_irq(&tuxedo_io_files_lock);
+
+	tuxedo_io_sampler_put(io_file);
+
+	kfree(io_file);
 
 	return 0;
 }
 
+static bool tuxedo_io_file_pending(struct tuxedo_io_file_t *io_file)
+{
+	bool pending;
+
+	spin_lock_irq(&tuxedo_io_files_lock);
+	pending = io_file->lost || !kfifo_is_empty(&io_file->events);
+	spin_unlock_irq(&tuxedo_io_files_lock);
+
+	return pending;
+}
+
+static int fop_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > PAGE_SIZE)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	tuxedo_io_sampler_get(file->private_data);
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+	vma->vm_flags &= ~VM_MAYWRITE;
+#else
+	vm_flags_clear(vma, VM_MAYWRITE);
+#endif
+
+	return remap_pfn_range(vma, vma->vm_start, virt_to_phys(tuxedo_io_telemetry) >> PAGE_SHIFT,
+			       vma->vm_end - vma->vm_start, vma->vm_page_prot);
+}
+
+static ssize_t fop_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+	struct tuxedo_io_file_t *io_file = file->private_data;
+	struct tuxedo_io_event events[TUXEDO_IO_EVENT_READ_BATCH];
+	unsigned int max_events = min_t(size_t, count / sizeof(events[0]), ARRAY_SIZE(events));
+	unsigned int n = 0;
+	int err;
+
+	if (max_events == 0)
+		return -EINVAL;
+
+	tuxedo_io_sampler_get(io_file);
+
+	do {
+		if (!tuxedo_io_file_pending(io_file)) {
+			if (file->f_flags & O_NONBLOCK)
+				return -EAGAIN;
+			err = wait_event_interruptible(tuxedo_io_event_wait, tuxedo_io_file_pending(io_file));
+			if (err)
+				return err;
+		}
+
+		// Another reader on the same file may have emptied the queue meanwhile
+		spin_lock_irq(&tuxedo_io_files_lock);
+		if (io_file->lost) {
+			memset(&events[0], 0, sizeof(events[0]));
+			events[0].type = TUXEDO_IO_EVENT_OVERFLOW;
+			events[0].value = io_file->lost;
+			events[0].timestamp_ns = ktime_get_ns();
+			io_file->lost = 0;
+			n = 1;
+		}
+		n += kfifo_out(&io_file->events, &events[n], max_events - n);
+		spin_unlock_irq(&tuxedo_io_files_lock);
+	} while (n == 0);
+
+	if (copy_to_user(buf, events, n * sizeof(events[0])))
+		return -EFAULT;
+
+	return n * sizeof(events[0]);
+}
+
+static __poll_t fop_poll(struct file *file, poll_table *wait)
+{
+	struct tuxedo_io_file_t *io_file = file->private_data;
+
+	tuxedo_io_sampler_get(io_file);
+	poll_wait(file, &tuxedo_io_event_wait, wait);
+
+	return tuxedo_io_file_pending(io_file) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
 static struct file_operations fops_dev = {
 	.owner              = THIS_MODULE,
-	.unlocked_ioctl     = fop_ioctl
-//	.open               = fop_open,
-//	.release            = fop_release
+	.unlocked_ioctl     = fop_ioctl,
+	.open               = fop_open,
+	.release            = fop_release,
+	.read               = fop_read,
+	.poll               = fop_poll,
+	.mmap               = fop_mmap
 };
 
 struct class *tuxedo_io_device_class;
@@ -779,6 +1958,7 @@ static int __init tuxedo_io_init(void)
 	// Hardware identification
 	id_check_clevo = clevo_identify();
 	id_check_uniwill = uniwill_identify();
+	tuxedo_io_caps_update();
 
 #ifdef DEBUG
 	pr_debug("DEBUG is defined\n");
@@ -788,9 +1968,14 @@ static int __init tuxedo_io_init(void)
 	}
 #endif
 
+	tuxedo_io_telemetry = (struct tuxedo_io_telemetry *)get_zeroed_page(GFP_KERNEL);
+	if (!tuxedo_io_telemetry)
+		return -ENOMEM;
+
 	err = alloc_chrdev_region(&tuxedo_io_device_handle, 0, 1, "tuxedo_io_cdev");
 	if (err != 0) {
 		pr_err("Failed to allocate chrdev region\n");
+		free_page((unsigned long)tuxedo_io_telemetry);
 		return err;
 	}
 	cdev_init(&tuxedo_io_cdev, &fops_dev);
@@ -807,6 +1992,18 @@ static int __init tuxedo_io_init(void)
 #endif
 
 	device_create(tuxedo_io_device_class, NULL, tuxedo_io_device_handle, NULL, "tuxedo_io");
+
+	clevo_register_event_notifier(&clevo_event_nb);
+	uniwill_register_event_notifier(&uniwill_event_nb);
+
+	tuxedo_io_debugfs_dir = debugfs_create_dir("tuxedo_io", NULL);
+	debugfs_create_file("ioctl_stats", 0600, tuxedo_io_debugfs_dir, NULL, &tuxedo_io_ioctl_stats_fops);
+	debugfs_create_u32("clevo_fan_settle_us_last", 0444, tuxedo_io_debugfs_dir, &clevo_fan_settle_us_last);
+	debugfs_create_u32("clevo_fan_settle_us_max", 0444, tuxedo_io_debugfs_dir, &clevo_fan_settle_us_max);
+
+	// Last, nothing after this may fail and leave the zone registered
+	uw_powercap_init();
+
 	pr_debug("Module init successful\n");
 	
 	return 0;
@@ -814,10 +2011,31 @@ static int __init tuxedo_io_init(void)
 
 static void __exit tuxedo_io_exit(void)
 {
+	bool fan_curves_active;
+
+	mutex_lock(&tuxedo_io_fan_curve_lock);
+	fan_curves_active = tuxedo_io_fan_curves_active();
+	mutex_unlock(&tuxedo_io_fan_curve_lock);
+	tuxedo_io_fan_curves_clear();
+	cancel_delayed_work_sync(&tuxedo_io_fan_curve_work);
+
+	// Hand the fans back to the firmware if a curve was still running
+	if (fan_curves_active) {
+		if (id_check_clevo)
+			clevo_evaluate_method(CLEVO_CMD_SET_FANSPEED_AUTO, 0, NULL);
+		else if (id_check_uniwill)
+			uw_set_fan_auto();
+	}
+
+	debugfs_remove_recursive(tuxedo_io_debugfs_dir);
+	uw_powercap_remove();
+	uniwill_unregister_event_notifier(&uniwill_event_nb);
+	clevo_unregister_event_notifier(&clevo_event_nb);
 	device_destroy(tuxedo_io_device_class, tuxedo_io_device_handle);
 	class_destroy(tuxedo_io_device_class);
 	cdev_del(&tuxedo_io_cdev);
 	unregister_chrdev_region(tuxedo_io_device_handle, 1);
+	free_page((unsigned long)tuxedo_io_telemetry);
 	pr_debug("Module exit\n");
 }
 
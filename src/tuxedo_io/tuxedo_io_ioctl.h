@@ -29,7 +29,7 @@
 #define MAGIC_READ_UW	IOCTL_MAGIC + 3
 #define MAGIC_WRITE_UW	IOCTL_MAGIC + 4
 
-#define MOD_API_MIN_VERSION "0.2.6" // IMPORTANT: Needs to be updated when a new ioctl is added
+#define MOD_API_MIN_VERSION "0.3.17" // IMPORTANT: Needs to be updated when a new ioctl is added
 
 // General
 #define R_MOD_VERSION		_IOR(IOCTL_MAGIC, 0x00, char*)
@@ -37,6 +37,120 @@
 #define R_HWCHECK_CL		_IOR(IOCTL_MAGIC, 0x05, int32_t*)
 #define R_HWCHECK_UW		_IOR(IOCTL_MAGIC, 0x06, int32_t*)
 
+/*
+ * Everything userspace would otherwise probe by trial, computed once at module
+ * load and again when R_HWCHECK_CL/R_HWCHECK_UW see a different result.
+ * Unsupported TDP values hold the negative error R_UW_TDP*_MIN/MAX would return.
+ */
+#define TUXEDO_IO_CAPABILITIES_VERSION	1
+
+#define TUXEDO_IO_CAP_CLEVO			(1 << 0) // as R_HWCHECK_CL
+#define TUXEDO_IO_CAP_UNIWILL			(1 << 1) // as R_HWCHECK_UW
+#define TUXEDO_IO_CAP_CL_WEBCAM_SW		(1 << 2)
+#define TUXEDO_IO_CAP_UW_FANS_OFF		(1 << 3) // as R_UW_FANS_OFF_AVAILABLE
+#define TUXEDO_IO_CAP_UW_EC_FAN_CURVE		(1 << 4) // W_UW_FAN_CURVE supported
+#define TUXEDO_IO_CAP_UW_CUSTOM_PROFILE_MODE	(1 << 5)
+#define TUXEDO_IO_CAP_UW_TDP0			(1 << 6)
+#define TUXEDO_IO_CAP_UW_TDP1			(1 << 7)
+#define TUXEDO_IO_CAP_UW_TDP2			(1 << 8)
+
+struct tuxedo_io_capabilities {
+	uint32_t version;
+	uint32_t flags;
+	int32_t uw_model;		// as R_UW_MODEL_ID
+	int32_t uw_profs_available;	// as R_UW_PROFS_AVAILABLE
+	int32_t fans_min_speed;		// as R_UW_FANS_MIN_SPEED
+	int32_t tdp_min[3];
+	int32_t tdp_max[3];
+};
+
+#define R_CAPABILITIES		_IOR(IOCTL_MAGIC, 0x07, struct tuxedo_io_capabilities*)
+
+/*
+ * Events, read() on the device returns whole struct tuxedo_io_event records
+ * from a per open file queue, poll() signals POLLIN while records are queued.
+ * Fan speed, temperature and profile changes are sampled by the driver every
+ * sample_interval_ms while an open file of the device has been read, polled
+ * or mapped, the others come from the firmware. If the queue overflows the
+ * oldest records are dropped and a TUXEDO_IO_EVENT_OVERFLOW record with the
+ * number of lost records is delivered first.
+ */
+#define TUXEDO_IO_EVENT_OVERFLOW	0 // value: number of dropped records
+#define TUXEDO_IO_EVENT_FAN_SPEED	1 // index: fan, value: speed as R_UW_FANSPEED* / faninfo duty
+#define TUXEDO_IO_EVENT_TEMP		2 // index: fan, value: temperature °C, crossed an event_temp_step boundary
+#define TUXEDO_IO_EVENT_PROFILE		3 // value: new mode as R_UW_MODE
+#define TUXEDO_IO_EVENT_AC_ADAPTER	4 // power supply state has to be read from power_supply
+#define TUXEDO_IO_EVENT_HW		5 // value: raw firmware event code
+
+struct tuxedo_io_event {
+	uint32_t type;
+	uint32_t index;
+	int32_t value;
+	uint32_t reserved;
+	uint64_t timestamp_ns; // CLOCK_MONOTONIC
+};
+
+/*
+ * Telemetry, mmap() the first page of the device read-only. Updated by the
+ * same sampler as the events while the mapping exists, valid has a
+ * TUXEDO_IO_TELEMETRY_* bit set for every value of the last sample.
+ * Fan speeds are in the same units as the vendor specific reads.
+ *
+ * seq is odd while the page is updated, readers retry until they see the
+ * same even seq before and after copying the values:
+ *
+ *	do {
+ *		seq = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+ *		copy = *page;
+ *		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+ *	} while ((seq & 1) || seq != __atomic_load_n(&page->seq, __ATOMIC_RELAXED));
+ */
+#define TUXEDO_IO_TELEMETRY_VERSION	1
+
+#define TUXEDO_IO_TELEMETRY_FAN0	(1 << 0)
+#define TUXEDO_IO_TELEMETRY_FAN1	(1 << 1)
+#define TUXEDO_IO_TELEMETRY_FAN2	(1 << 2)
+#define TUXEDO_IO_TELEMETRY_MODE	(1 << 3)
+#define TUXEDO_IO_TELEMETRY_TDP0	(1 << 4)
+#define TUXEDO_IO_TELEMETRY_TDP1	(1 << 5)
+#define TUXEDO_IO_TELEMETRY_TDP2	(1 << 6)
+
+struct tuxedo_io_telemetry {
+	uint32_t seq;
+	uint32_t version;
+	uint32_t valid;
+	uint32_t interval_ms;
+	uint64_t timestamp_ns; // CLOCK_MONOTONIC of the last sample
+	int32_t fanspeed[3];
+	int32_t fan_temp[3];
+	int32_t mode;
+	int32_t tdp[3];
+};
+
+/*
+ * Kernel side fan curve for one fan, evaluated by the driver every
+ * sample_interval_ms even while no process has the device open. Points map
+ * temp[i] (°C, strictly increasing) to duty[i] (percent) up to temp[i + 1].
+ * A lower duty only applies once the temperature dropped hysteresis °C (up to
+ * TUXEDO_IO_FAN_CURVE_MAX_HYSTERESIS) below its point, and the duty of a fan
+ * changes at most every min_interval_ms.
+ * num_points 0 removes the curve of that fan. Any fan speed, fan auto or EC
+ * fan table write removes all curves. On clevo all fans are set together, so
+ * the curves only take effect once every fan reported by the fan info has
+ * one, until then all fans stay in firmware auto control.
+ */
+#define TUXEDO_IO_FAN_CURVE_MAX_POINTS	16
+#define TUXEDO_IO_FAN_CURVE_MAX_HYSTERESIS	255
+
+struct tuxedo_io_fan_curve {
+	int32_t fan_index;
+	int32_t num_points;
+	int32_t hysteresis;
+	int32_t min_interval_ms;
+	uint8_t temp[TUXEDO_IO_FAN_CURVE_MAX_POINTS];
+	uint8_t duty[TUXEDO_IO_FAN_CURVE_MAX_POINTS];
+};
+
 /**
  * Clevo interface
  */
@@ -52,18 +166,42 @@
 #define R_CL_FLIGHTMODE_SW	_IOR(MAGIC_READ_CL, 0x14, int32_t*)
 #define R_CL_TOUCHPAD_SW	_IOR(MAGIC_READ_CL, 0x15, int32_t*)
 
+/*
+ * All fan info values in one call. valid has TUXEDO_IO_CL_SNAPSHOT_FANINFOx
+ * set for every value that could be read.
+ */
+#define TUXEDO_IO_CL_SNAPSHOT_VERSION	1
+
+#define TUXEDO_IO_CL_SNAPSHOT_FANINFO1	(1 << 0)
+#define TUXEDO_IO_CL_SNAPSHOT_FANINFO2	(1 << 1)
+#define TUXEDO_IO_CL_SNAPSHOT_FANINFO3	(1 << 2)
+
+struct tuxedo_io_cl_snapshot {
+	uint32_t version;
+	uint32_t valid;
+	int32_t faninfo[3];
+};
+
+#define R_CL_SNAPSHOT		_IOR(MAGIC_READ_CL, 0x16, struct tuxedo_io_cl_snapshot*)
+
+// Average time in µs until a W_CL_FANSPEED_SYNC write showed up in the fan info, 0 if not measured yet
+#define R_CL_FAN_SETTLE_US	_IOR(MAGIC_READ_CL, 0x17, int32_t*)
+
 #ifdef DEBUG
 #define R_TF_BC			_IOW(MAGIC_READ_CL, 0x91, uint32_t*)
 #endif
 
 // Write
-#define W_CL_FANSPEED		_IOW(MAGIC_WRITE_CL, 0x10, int32_t*)
+#define W_CL_FANSPEED		_IOW(MAGIC_WRITE_CL, 0x10, int32_t*) // returns before the fan info reflects the new duty
 #define W_CL_FANAUTO		_IOW(MAGIC_WRITE_CL, 0x11, int32_t*)
 
 #define W_CL_WEBCAM_SW		_IOW(MAGIC_WRITE_CL, 0x12, int32_t*)
 #define W_CL_FLIGHTMODE_SW	_IOW(MAGIC_WRITE_CL, 0x13, int32_t*)
 #define W_CL_TOUCHPAD_SW	_IOW(MAGIC_WRITE_CL, 0x14, int32_t*)
 #define W_CL_PERF_PROFILE	_IOW(MAGIC_WRITE_CL, 0x15, int32_t*)
+#define W_CL_SW_FAN_CURVE	_IOW(MAGIC_WRITE_CL, 0x16, struct tuxedo_io_fan_curve*) // fan_index 0 - 2
+// As W_CL_FANSPEED, returns once the fan info reflects the new duty or -ETIMEDOUT
+#define W_CL_FANSPEED_SYNC	_IOW(MAGIC_WRITE_CL, 0x17, int32_t*)
 
 #ifdef DEBUG
 #define W_TF_BC			_IOW(MAGIC_WRITE_CL, 0x91, uint32_t*)
@@ -98,6 +236,32 @@
 
 #define R_UW_PROFS_AVAILABLE	_IOR(MAGIC_READ_UW, 0x21, int32_t*)
 
+/*
+ * Fan speeds, temperatures, mode and TDP values in one call with the same
+ * semantics as the single R_UW_* reads. valid has a TUXEDO_IO_UW_SNAPSHOT_*
+ * bit set for every group that could be read.
+ */
+#define TUXEDO_IO_UW_SNAPSHOT_VERSION	1
+
+#define TUXEDO_IO_UW_SNAPSHOT_FANSPEED	(1 << 0)
+#define TUXEDO_IO_UW_SNAPSHOT_FAN_TEMP	(1 << 1)
+#define TUXEDO_IO_UW_SNAPSHOT_MODE	(1 << 2)
+#define TUXEDO_IO_UW_SNAPSHOT_TDP0	(1 << 3)
+#define TUXEDO_IO_UW_SNAPSHOT_TDP1	(1 << 4)
+#define TUXEDO_IO_UW_SNAPSHOT_TDP2	(1 << 5)
+
+struct tuxedo_io_uw_snapshot {
+	uint32_t version;
+	uint32_t valid;
+	int32_t fanspeed[2];
+	int32_t fan_temp[2];
+	int32_t mode;
+	int32_t mode_enable;
+	int32_t tdp[3];
+};
+
+#define R_UW_SNAPSHOT		_IOR(MAGIC_READ_UW, 0x22, struct tuxedo_io_uw_snapshot*)
+
 // Write
 #define W_UW_FANSPEED		_IOW(MAGIC_WRITE_UW, 0x10, int32_t*)
 #define W_UW_FANSPEED2		_IOW(MAGIC_WRITE_UW, 0x11, int32_t*)
@@ -109,6 +273,33 @@
 #define W_UW_TDP1		_IOW(MAGIC_WRITE_UW, 0x16, int32_t*)
 #define W_UW_TDP2		_IOW(MAGIC_WRITE_UW, 0x17, int32_t*)
 
+/*
+ * All TDP values at once, either all are applied or none (-EINVAL if one is
+ * out of range). Values for unsupported TDP indices are ignored.
+ */
+struct tuxedo_io_uw_tdp_all {
+	int32_t tdp[3];
+};
+
+#define W_UW_TDP_ALL		_IOW(MAGIC_WRITE_UW, 0x1b, struct tuxedo_io_uw_tdp_all*)
+
 #define W_UW_PERF_PROF		_IOW(MAGIC_WRITE_UW, 0x18, int32_t*)
 
+/*
+ * Upload a fan curve into the EC fan tables (universal EC fan control only).
+ * Point i sets speed[i] (0 - 0xc8) from temp[i] up to temp[i + 1], temps have
+ * to be strictly increasing and below 115 °C and temp[0] has to be 0 °C.
+ */
+#define TUXEDO_IO_UW_FAN_CURVE_MAX_POINTS	16
+
+struct tuxedo_io_uw_fan_curve {
+	int32_t fan_index;
+	int32_t num_points;
+	uint8_t temp[TUXEDO_IO_UW_FAN_CURVE_MAX_POINTS];
+	uint8_t speed[TUXEDO_IO_UW_FAN_CURVE_MAX_POINTS];
+};
+
+#define W_UW_FAN_CURVE		_IOW(MAGIC_WRITE_UW, 0x19, struct tuxedo_io_uw_fan_curve*)
+#define W_UW_SW_FAN_CURVE	_IOW(MAGIC_WRITE_UW, 0x1a, struct tuxedo_io_fan_curve*) // fan_index 0 - 1
+
 #endif
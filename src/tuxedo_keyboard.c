@@ -29,6 +29,9 @@
 #include <asm/intel-family.h>
 #include <linux/mod_devicetable.h>
 
+#define CREATE_TRACE_POINTS
+#include "clevo_trace.h"
+
 MODULE_AUTHOR("TUXEDO Computers GmbH <tux@tuxedocomputers.com>");
 MODULE_DESCRIPTION("TUXEDO Computers keyboard & keyboard backlight Driver");
 MODULE_LICENSE("GPL");
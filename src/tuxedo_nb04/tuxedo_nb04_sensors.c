@@ -22,8 +22,13 @@
 #include <linux/module.h>
 #include <linux/hwmon.h>
 #include <linux/platform_device.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
 #include "tuxedo_nb04_wmi_bs.h"
 
+#define SENSORS_UPDATE_INTERVAL_DEFAULT_MS 1000
+#define SENSORS_UPDATE_INTERVAL_MAX_MS 60000
+
 static int read_cpu_info(u8 *cpu_temp, u8 *cpu_turbo_mode)
 {
 	int err, wmi_return;
@@ -100,6 +105,25 @@ static int read_fan_setting(u16 *fan1_cur_rpm, u16 *fan2_cur_rpm,
 	return 0;
 }
 
+// Result per BS method, attributes only fail if the method they come from failed
+struct sensors_snapshot_t {
+	int cpu_info_err;
+	int gpu_info_err;
+	int fan_setting_err;
+	u8 cpu_temp;
+	u8 gpu_temp;
+	u16 fan1_rpm;
+	u16 fan2_rpm;
+};
+
+static void read_sensors_snapshot(struct sensors_snapshot_t *snapshot)
+{
+	snapshot->cpu_info_err = read_cpu_info(&snapshot->cpu_temp, NULL);
+	snapshot->gpu_info_err = read_gpu_info(&snapshot->gpu_temp, NULL, NULL);
+	snapshot->fan_setting_err = read_fan_setting(&snapshot->fan1_rpm, &snapshot->fan2_rpm,
+						     NULL, NULL, NULL);
+}
+
 static const char * const temp_labels[] = {
 	"cpu0",
 	"gpu0"
@@ -115,14 +139,43 @@ struct driver_data_t {
 	int fan_cpu_min;
 	int fan_gpu_max;
 	int fan_gpu_min;
+	struct mutex snapshot_lock;
+	struct sensors_snapshot_t snapshot;
+	unsigned long snapshot_jiffies;
+	bool snapshot_valid;
+	long update_interval;
 };
 
 struct driver_data_t driver_data;
 
+/*
+ * All input attributes are served from one snapshot of the three WMI
+ * methods, refreshed at most once per update_interval. Failed methods are
+ * cached like successful ones, so a broken method does not cause extra
+ * WMI calls.
+ */
+static void get_sensors_snapshot(struct driver_data_t *driver_data,
+				 struct sensors_snapshot_t *snapshot)
+{
+	mutex_lock(&driver_data->snapshot_lock);
+	if (!driver_data->snapshot_valid ||
+	    time_after(jiffies, driver_data->snapshot_jiffies +
+			       msecs_to_jiffies(driver_data->update_interval))) {
+		read_sensors_snapshot(&driver_data->snapshot);
+		driver_data->snapshot_valid = true;
+		driver_data->snapshot_jiffies = jiffies;
+	}
+	*snapshot = driver_data->snapshot;
+	mutex_unlock(&driver_data->snapshot_lock);
+}
+
 static umode_t
 tuxedo_nb04_sensors_is_visible(const void *drvdata, enum hwmon_sensor_types type,
 			       u32 attr, int channel)
 {
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval)
+		return 0644;
+
 	return 0444;
 }
 
@@ -130,24 +183,27 @@ static int
 tuxedo_nb04_sensors_read(struct device *dev, enum hwmon_sensor_types type,
 			 u32 attr, int channel, long *val)
 {
-	int err;
-	u8 temp_data;
-	u16 rpm_data;
+	struct sensors_snapshot_t snapshot;
 	struct driver_data_t *driver_data = dev_get_drvdata(dev);
 
 	switch (type) {
+	case hwmon_chip:
+		if (attr == hwmon_chip_update_interval) {
+			*val = driver_data->update_interval;
+			return 0;
+		}
+		break;
 	case hwmon_temp:
+		get_sensors_snapshot(driver_data, &snapshot);
 		if (channel == 0) {
-			err = read_cpu_info(&temp_data, NULL);
-			if (err)
-				return err;
-			*val = temp_data * 1000;
+			if (snapshot.cpu_info_err)
+				return snapshot.cpu_info_err;
+			*val = snapshot.cpu_temp * 1000;
 			return 0;
 		} else if (channel == 1) {
-			err = read_gpu_info(&temp_data, NULL, NULL);
-			if (err)
-				return err;
-			*val = temp_data * 1000;
+			if (snapshot.gpu_info_err)
+				return snapshot.gpu_info_err;
+			*val = snapshot.gpu_temp * 1000;
 			return 0;
 		}
 		break;
@@ -172,17 +228,14 @@ tuxedo_nb04_sensors_read(struct device *dev, enum hwmon_sensor_types type,
 			}
 			break;
 		case hwmon_fan_input:
+			get_sensors_snapshot(driver_data, &snapshot);
+			if (snapshot.fan_setting_err)
+				return snapshot.fan_setting_err;
 			if (channel == 0) {
-				err = read_fan_setting(&rpm_data, NULL, NULL, NULL, NULL);
-				if (err)
-					return err;
-				*val = rpm_data;
+				*val = snapshot.fan1_rpm;
 				return 0;
 			} else if (channel == 1) {
-				err = read_fan_setting(NULL, &rpm_data, NULL, NULL, NULL);
-				if (err)
-					return err;
-				*val = rpm_data;
+				*val = snapshot.fan2_rpm;
 				return 0;
 			}
 			break;
@@ -196,6 +249,22 @@ tuxedo_nb04_sensors_read(struct device *dev, enum hwmon_sensor_types type,
 	return -EOPNOTSUPP;
 }
 
+static int
+tuxedo_nb04_sensors_write(struct device *dev, enum hwmon_sensor_types type,
+			  u32 attr, int channel, long val)
+{
+	struct driver_data_t *driver_data = dev_get_drvdata(dev);
+
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval) {
+		mutex_lock(&driver_data->snapshot_lock);
+		driver_data->update_interval = clamp_val(val, 0, SENSORS_UPDATE_INTERVAL_MAX_MS);
+		mutex_unlock(&driver_data->snapshot_lock);
+		return 0;
+	}
+
+	return -EOPNOTSUPP;
+}
+
 static int
 tuxedo_nb04_sensors_read_string(struct device *dev, enum hwmon_sensor_types type,
 				u32 attr, int channel, const char **str)
@@ -217,10 +286,13 @@ tuxedo_nb04_sensors_read_string(struct device *dev, enum hwmon_sensor_types type
 static const struct hwmon_ops tuxedo_nb04_sensors_ops = {
 	.is_visible = tuxedo_nb04_sensors_is_visible,
 	.read = tuxedo_nb04_sensors_read,
+	.write = tuxedo_nb04_sensors_write,
 	.read_string = tuxedo_nb04_sensors_read_string
 };
 
 static const struct hwmon_channel_info *const tuxedo_nb04_sensors_info[] = {
+	HWMON_CHANNEL_INFO(chip,
+			   HWMON_C_UPDATE_INTERVAL),
 	HWMON_CHANNEL_INFO(temp,
 			   HWMON_T_INPUT | HWMON_T_LABEL,
 			   HWMON_T_INPUT | HWMON_T_LABEL),
@@ -250,6 +322,10 @@ static int __init tuxedo_nb04_sensors_probe(struct platform_device *pdev)
 	driver_data.fan_gpu_max = fan2_max_rpm;
 	driver_data.fan_gpu_min = 0;
 
+	mutex_init(&driver_data.snapshot_lock);
+	driver_data.snapshot_valid = false;
+	driver_data.update_interval = SENSORS_UPDATE_INTERVAL_DEFAULT_MS;
+
 	hwmon_dev = devm_hwmon_device_register_with_info(&pdev->dev,
 							 "tuxedo",
 							 &driver_data,
@@ -24,9 +24,13 @@
 #include <linux/wmi.h>
 #include <linux/version.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include "tuxedo_nb04_wmi_ab.h"
 #include "../tuxedo_compatibility_check/tuxedo_compatibility_check.h"
 
+#define CREATE_TRACE_POINTS
+#include "tuxedo_nb04_wmi_ab_trace.h"
+
 #define dev_to_wdev(__dev)	container_of(__dev, struct wmi_device, dev)
 
 static DEFINE_MUTEX(nb04_wmi_ab_lock);
@@ -49,6 +53,8 @@ __nb04_wmi_ab_method_buffer(struct wmi_device *wdev, u32 wmi_method_id,
 	struct acpi_buffer return_buffer = { ACPI_ALLOCATE_BUFFER, NULL };
 	union acpi_object *acpi_object_out;
 	acpi_status status;
+	int result = 0;
+	u64 start_ns = ktime_get_ns();
 
 	mutex_lock(&nb04_wmi_ab_lock);
 	pr_debug("evaluate: %u\n", wmi_method_id);
@@ -58,30 +64,38 @@ __nb04_wmi_ab_method_buffer(struct wmi_device *wdev, u32 wmi_method_id,
 
 	if (ACPI_FAILURE(status)) {
 		pr_err("failed to evaluate wmi method %u\n", wmi_method_id);
-		return -EIO;
+		result = -EIO;
+		goto out;
 	}
 
 	acpi_object_out = (union acpi_object *) return_buffer.pointer;
-	if (!acpi_object_out)
-		return -ENODATA;
+	if (!acpi_object_out) {
+		result = -ENODATA;
+		goto out;
+	}
 
 	if (acpi_object_out->type != ACPI_TYPE_BUFFER) {
 		pr_err("No buffer for method (%u) call\n", wmi_method_id);
-		kfree(return_buffer.pointer);
-		return -EIO;
+		result = -EIO;
+		goto free;
 	}
 
 	if (acpi_object_out->buffer.length != AB_OUTPUT_BUFFER_LENGTH) {
 		pr_err("Unexpected buffer length: %u for method (%u) call\n", 
 		       acpi_object_out->buffer.length, wmi_method_id);
-		kfree(return_buffer.pointer);
-		return -EIO;
+		result = -EIO;
+		goto free;
 	}
 
 	memcpy(out, acpi_object_out->buffer.pointer, AB_OUTPUT_BUFFER_LENGTH);
+
+free:
 	kfree(return_buffer.pointer);
+out:
+	trace_nb04_wmi_ab_method(wmi_method_id, in[0], result ? 0 : out[0],
+				 ktime_get_ns() - start_ns, result);
 
-	return 0;
+	return result;
 }
 
 /**
@@ -104,6 +118,8 @@ __nb04_wmi_ab_method_buffer_reduced_output(struct wmi_device *wdev, u32 wmi_meth
 	struct acpi_buffer return_buffer = { ACPI_ALLOCATE_BUFFER, NULL };
 	union acpi_object *acpi_object_out;
 	acpi_status status;
+	int result = 0;
+	u64 start_ns = ktime_get_ns();
 
 	mutex_lock(&nb04_wmi_ab_lock);
 	pr_debug("evaluate: %u\n", wmi_method_id);
@@ -112,30 +128,38 @@ __nb04_wmi_ab_method_buffer_reduced_output(struct wmi_device *wdev, u32 wmi_meth
 	mutex_unlock(&nb04_wmi_ab_lock);
 	if (ACPI_FAILURE(status)) {
 		pr_err("failed to evaluate wmi method %u\n", wmi_method_id);
-		return -EIO;
+		result = -EIO;
+		goto out;
 	}
 
 	acpi_object_out = (union acpi_object *) return_buffer.pointer;
-	if (!acpi_object_out)
-		return -ENODATA;
+	if (!acpi_object_out) {
+		result = -ENODATA;
+		goto out;
+	}
 
 	if (acpi_object_out->type != ACPI_TYPE_BUFFER) {
 		pr_err("No buffer for method (%u) call\n", wmi_method_id);
-		kfree(return_buffer.pointer);
-		return -EIO;
+		result = -EIO;
+		goto free;
 	}
 
 	if (acpi_object_out->buffer.length != AB_OUTPUT_BUFFER_LENGTH_REDUCED) {
 		pr_err("Unexpected buffer length: %u for method (%u) call\n", 
 		       acpi_object_out->buffer.length, wmi_method_id);
-		kfree(return_buffer.pointer);
-		return -EIO;
+		result = -EIO;
+		goto free;
 	}
 
 	memcpy(out, acpi_object_out->buffer.pointer, AB_OUTPUT_BUFFER_LENGTH_REDUCED);
+
+free:
 	kfree(return_buffer.pointer);
+out:
+	trace_nb04_wmi_ab_method(wmi_method_id, in[0], result ? 0 : out[0],
+				 ktime_get_ns() - start_ns, result);
 
-	return 0;
+	return result;
 }
 
 /**
@@ -23,9 +23,13 @@
 #include <linux/module.h>
 #include <linux/wmi.h>
 #include <linux/version.h>
+#include <linux/ktime.h>
 #include "../tuxedo_compatibility_check/tuxedo_compatibility_check.h"
 #include "tuxedo_nb04_wmi_bs.h"
 
+#define CREATE_TRACE_POINTS
+#include "tuxedo_nb04_wmi_bs_trace.h"
+
 #define BS_INPUT_BUFFER_LENGTH	8
 #define BS_OUTPUT_BUFFER_LENGTH	80
 
@@ -51,6 +55,8 @@ static int __nb04_wmi_bs_method(struct wmi_device *wdev, u32 wmi_method_id,
 	struct acpi_buffer return_buffer = { ACPI_ALLOCATE_BUFFER, NULL };
 	union acpi_object *acpi_object_out;
 	acpi_status status;
+	int result = 0;
+	u64 start_ns = ktime_get_ns();
 
 	mutex_lock(&nb04_wmi_bs_access_lock);
 
@@ -62,30 +68,38 @@ static int __nb04_wmi_bs_method(struct wmi_device *wdev, u32 wmi_method_id,
 
 	if (ACPI_FAILURE(status)) {
 		pr_err("failed to evaluate wmi method %u\n", wmi_method_id);
-		return -EIO;
+		result = -EIO;
+		goto out;
 	}
 
 	acpi_object_out = (union acpi_object *) return_buffer.pointer;
-	if (!acpi_object_out)
-		return -ENODATA;
+	if (!acpi_object_out) {
+		result = -ENODATA;
+		goto out;
+	}
 
 	if (acpi_object_out->type != ACPI_TYPE_BUFFER) {
 		// Returns an int 0 when not finding a valid method number
-		kfree(return_buffer.pointer);
-		return -EINVAL;
+		result = -EINVAL;
+		goto free;
 	}
 
 	if (acpi_object_out->buffer.length != BS_OUTPUT_BUFFER_LENGTH) {
 		pr_err("Unexpected buffer length: %u for method (%u) call\n", 
 		       acpi_object_out->buffer.length, wmi_method_id);
-		kfree(return_buffer.pointer);
-		return -EIO;
+		result = -EIO;
+		goto free;
 	}
 
 	memcpy(out, acpi_object_out->buffer.pointer, BS_OUTPUT_BUFFER_LENGTH);
+
+free:
 	kfree(return_buffer.pointer);
+out:
+	trace_nb04_wmi_bs_method(wmi_method_id, in[0], result ? 0 : out[0],
+				 ktime_get_ns() - start_ns, result);
 
-	return 0;
+	return result;
 }
 
 /**
@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*!
+ * Copyright (c) 2025 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-drivers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tuxedo_nb04_wmi_bs
+
+#if !defined(TUXEDO_NB04_WMI_BS_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define TUXEDO_NB04_WMI_BS_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * WMI method call, in0/out0 are the first bytes of the in- and output buffers
+ */
+TRACE_EVENT(nb04_wmi_bs_method,
+
+	TP_PROTO(u32 method_id, u8 in0, u8 out0, u64 duration_ns, int status),
+
+	TP_ARGS(method_id, in0, out0, duration_ns, status),
+
+	TP_STRUCT__entry(
+		__field(u32, method_id)
+		__field(u8, in0)
+		__field(u8, out0)
+		__field(u64, duration_ns)
+		__field(int, status)
+	),
+
+	TP_fast_assign(
+		__entry->method_id = method_id;
+		__entry->in0 = in0;
+		__entry->out0 = out0;
+		__entry->duration_ns = duration_ns;
+		__entry->status = status;
+	),
+
+	TP_printk("method=%u in0=0x%02x out0=0x%02x duration_ns=%llu status=%d",
+		  __entry->method_id, __entry->in0, __entry->out0,
+		  __entry->duration_ns, __entry->status)
+);
+
+#endif // TUXEDO_NB04_WMI_BS_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE tuxedo_nb04_wmi_bs_trace
+#include <trace/define_trace.h>
@@ -26,10 +26,14 @@
 #include <linux/dmi.h>
 #include <linux/acpi.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include <asm/io.h>
 #include "tuxedo_nb05_ec.h"
 #include "../tuxedo_compatibility_check/tuxedo_compatibility_check.h"
 
+#define CREATE_TRACE_POINTS
+#include "tuxedo_nb05_ec_trace.h"
+
 static struct nb05_ec_data_t ec_data;
 
 #define EC_PORT_ADDR	0x4e
@@ -56,45 +60,117 @@ static u8 io_read(u8 reg)
 	return inb(EC_PORT_DATA);
 }
 
-void nb05_read_ec_ram(u16 addr, u8 *data)
+/*
+ * Address bytes programmed into the I2EC bridge during one hold of
+ * nb05_ec_access_lock. Only bytes that differ from the previous access are
+ * rewritten, so consecutive addresses just update the low byte. Nothing is
+ * assumed across lock holds since firmware may use the same ports in between.
+ */
+struct nb05_i2ec_xfer_t {
+	int addr_high;
+	int addr_low;
+};
+
+#define NB05_I2EC_XFER_INIT { .addr_high = -1, .addr_low = -1 }
+
+static void i2ec_set_addr(struct nb05_i2ec_xfer_t *xfer, u16 addr)
 {
 	u8 addr_high = (addr >> 8) & 0xff;
 	u8 addr_low = (addr & 0xff);
 
-	mutex_lock(&nb05_ec_access_lock);
+	if (xfer->addr_high != addr_high) {
+		io_write(I2EC_REG_ADDR, I2EC_ADDR_HIGH);
+		io_write(I2EC_REG_DATA, addr_high);
+		xfer->addr_high = addr_high;
+	}
+
+	if (xfer->addr_low != addr_low) {
+		io_write(I2EC_REG_ADDR, I2EC_ADDR_LOW);
+		io_write(I2EC_REG_DATA, addr_low);
+		xfer->addr_low = addr_low;
+	}
+}
 
-	io_write(I2EC_REG_ADDR, I2EC_ADDR_HIGH);
-	io_write(I2EC_REG_DATA, addr_high);
+static u8 i2ec_read(struct nb05_i2ec_xfer_t *xfer, u16 addr)
+{
+	u64 start_ns = ktime_get_ns();
+	u8 data;
+
+	i2ec_set_addr(xfer, addr);
+	io_write(I2EC_REG_ADDR, I2EC_ADDR_DATA);
+	data = io_read(I2EC_REG_DATA);
 
-	io_write(I2EC_REG_ADDR, I2EC_ADDR_LOW);
-	io_write(I2EC_REG_DATA, addr_low);
+	trace_nb05_ec_read(addr, data, ktime_get_ns() - start_ns);
 
+	return data;
+}
+
+static void i2ec_write(struct nb05_i2ec_xfer_t *xfer, u16 addr, u8 data)
+{
+	u64 start_ns = ktime_get_ns();
+
+	i2ec_set_addr(xfer, addr);
 	io_write(I2EC_REG_ADDR, I2EC_ADDR_DATA);
-	*data = io_read(I2EC_REG_DATA);
+	io_write(I2EC_REG_DATA, data);
+
+	trace_nb05_ec_write(addr, data, ktime_get_ns() - start_ns);
+}
+
+void nb05_read_ec_ram(u16 addr, u8 *data)
+{
+	struct nb05_i2ec_xfer_t xfer = NB05_I2EC_XFER_INIT;
 
+	mutex_lock(&nb05_ec_access_lock);
+	*data = i2ec_read(&xfer, addr);
 	mutex_unlock(&nb05_ec_access_lock);
 }
 EXPORT_SYMBOL(nb05_read_ec_ram);
 
 void nb05_write_ec_ram(u16 addr, u8 data)
 {
-	u8 addr_high = (addr >> 8) & 0xff;
-	u8 addr_low = (addr & 0xff);
+	struct nb05_i2ec_xfer_t xfer = NB05_I2EC_XFER_INIT;
 
 	mutex_lock(&nb05_ec_access_lock);
+	i2ec_write(&xfer, addr, data);
+	mutex_unlock(&nb05_ec_access_lock);
+}
+EXPORT_SYMBOL(nb05_write_ec_ram);
 
-	io_write(I2EC_REG_ADDR, I2EC_ADDR_HIGH);
-	io_write(I2EC_REG_DATA, addr_high);
+void nb05_read_ec_range(u16 addr, u8 *data, u16 len)
+{
+	struct nb05_i2ec_xfer_t xfer = NB05_I2EC_XFER_INIT;
+	u16 i;
 
-	io_write(I2EC_REG_ADDR, I2EC_ADDR_LOW);
-	io_write(I2EC_REG_DATA, addr_low);
+	mutex_lock(&nb05_ec_access_lock);
+	for (i = 0; i < len; ++i)
+		data[i] = i2ec_read(&xfer, addr + i);
+	mutex_unlock(&nb05_ec_access_lock);
+}
+EXPORT_SYMBOL(nb05_read_ec_range);
 
-	io_write(I2EC_REG_ADDR, I2EC_ADDR_DATA);
-	io_write(I2EC_REG_DATA, data);
+void nb05_write_ec_range(u16 addr, const u8 *data, u16 len)
+{
+	struct nb05_i2ec_xfer_t xfer = NB05_I2EC_XFER_INIT;
+	u16 i;
 
+	mutex_lock(&nb05_ec_access_lock);
+	for (i = 0; i < len; ++i)
+		i2ec_write(&xfer, addr + i, data[i]);
 	mutex_unlock(&nb05_ec_access_lock);
 }
-EXPORT_SYMBOL(nb05_write_ec_ram);
+EXPORT_SYMBOL(nb05_write_ec_range);
+
+void nb05_read_ec_ram_multi(const u16 *addrs, u8 *data, u16 count)
+{
+	struct nb05_i2ec_xfer_t xfer = NB05_I2EC_XFER_INIT;
+	u16 i;
+
+	mutex_lock(&nb05_ec_access_lock);
+	for (i = 0; i < count; ++i)
+		data[i] = i2ec_read(&xfer, addrs[i]);
+	mutex_unlock(&nb05_ec_access_lock);
+}
+EXPORT_SYMBOL(nb05_read_ec_ram_multi);
 
 void nb05_read_ec_fw_version(u8 *major, u8 *minor)
 {
@@ -40,6 +40,11 @@ struct nb05_device_data_t {
 
 void nb05_read_ec_ram(u16 addr, u8 *data);
 void nb05_write_ec_ram(u16 addr, u8 data);
+// Consecutive addresses under one lock hold, address bytes only rewritten on change
+void nb05_read_ec_range(u16 addr, u8 *data, u16 len);
+void nb05_write_ec_range(u16 addr, const u8 *data, u16 len);
+// Arbitrary addresses under one lock hold, e.g. for coherent multi byte values
+void nb05_read_ec_ram_multi(const u16 *addrs, u8 *data, u16 count);
 void nb05_read_ec_fw_version(u8 *major, u8 *minor);
 void nb05_get_ec_data(struct nb05_ec_data_t **ec_data);
 
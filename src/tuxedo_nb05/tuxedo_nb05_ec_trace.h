@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*!
+ * Copyright (c) 2025 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-drivers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tuxedo_nb05_ec
+
+#if !defined(TUXEDO_NB05_EC_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define TUXEDO_NB05_EC_TRACE_H
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(nb05_ec_access,
+
+	TP_PROTO(u16 address, u8 value, u64 duration_ns),
+
+	TP_ARGS(address, value, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(u16, address)
+		__field(u8, value)
+		__field(u64, duration_ns)
+	),
+
+	TP_fast_assign(
+		__entry->address = address;
+		__entry->value = value;
+		__entry->duration_ns = duration_ns;
+	),
+
+	TP_printk("addr=0x%04x value=0x%02x duration_ns=%llu",
+		  __entry->address, __entry->value, __entry->duration_ns)
+);
+
+DEFINE_EVENT(nb05_ec_access, nb05_ec_read,
+	TP_PROTO(u16 address, u8 value, u64 duration_ns),
+	TP_ARGS(address, value, duration_ns)
+);
+
+DEFINE_EVENT(nb05_ec_access, nb05_ec_write,
+	TP_PROTO(u16 address, u8 value, u64 duration_ns),
+	TP_ARGS(address, value, duration_ns)
+);
+
+#endif // TUXEDO_NB05_EC_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE tuxedo_nb05_ec_trace
+#include <trace/define_trace.h>
@@ -24,6 +24,7 @@
 #include <linux/platform_device.h>
 #include <linux/slab.h>
 #include <linux/dmi.h>
+#include <linux/mutex.h>
 #include <linux/version.h>
 #include "tuxedo_nb05_ec.h"
 
@@ -38,6 +39,38 @@
 #define RPM_TO_PWM(rpm_data) ((rpm_data * 0xff) / FAN_SET_RPM_MAX)
 #define DUTY_TO_PWM(duty_data) ((duty_data * 0xff) / FAN_SET_DUTY_MAX)
 
+/*
+ * The range based EC fan control has one duty (and on older firmware one RPM)
+ * slot per built-in temperature range, the last two for the high temperature
+ * ranges. fanN_curve sets every slot on its own, the EC then follows the
+ * temperature by itself while fanN_pwm_enable is 1.
+ */
+#define FAN_CURVE_POINTS 9
+#define FAN_CURVE_POINTS_HIGHTEMP 2
+
+#define FAN1_DUTY_RANGES_BASE 0x02c1
+#define FAN1_RPM_RANGES_BASE 0x02d0
+#define FAN2_DUTY_RANGES_BASE 0x0241
+#define FAN2_RPM_RANGES_BASE 0x0250
+
+/*
+ * Last register image programmed into one range bank. Writes are diffed
+ * against it so that re-asserting the same speed causes no EC traffic and a
+ * partially changed curve only touches the changed slots. Invalidated
+ * whenever the EC might have changed the registers behind our back.
+ */
+struct fan_regs_shadow_t {
+	u16 base;
+	u8 regs[FAN_CURVE_POINTS];
+	bool valid;
+};
+
+static DEFINE_MUTEX(fan_regs_shadow_lock);
+static struct fan_regs_shadow_t fan1_duty_shadow = { .base = FAN1_DUTY_RANGES_BASE };
+static struct fan_regs_shadow_t fan1_rpm_shadow = { .base = FAN1_RPM_RANGES_BASE };
+static struct fan_regs_shadow_t fan2_duty_shadow = { .base = FAN2_DUTY_RANGES_BASE };
+static struct fan_regs_shadow_t fan2_rpm_shadow = { .base = FAN2_RPM_RANGES_BASE };
+
 struct driver_data_t {
 	struct platform_device *pdev;
 	struct nb05_ec_data_t *ec_data;
@@ -72,6 +105,13 @@ static ssize_t fan2_pwm_enable_store(struct device *dev,
 				     struct device_attribute *attr,
 				     const char *buffer, size_t size);
 
+static ssize_t fan_curve_show(struct device *dev,
+			      struct device_attribute *attr, char *buffer);
+
+static ssize_t fan_curve_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buffer, size_t size);
+
 static int write_fan1_rpm(u8 rpm_data);
 static u8 read_fan1_duty_ranges(void);
 static u8 read_fan1_duty_onereg(void);
@@ -86,10 +126,53 @@ static u8 read_fan2_duty(void);
 static int write_fan2_duty(u8 rpm_data);
 static bool read_fan2_enable(void);
 static int write_fan2_enable(bool enable_data);
+static int write_fan_curve(struct fan_regs_shadow_t *duty_shadow,
+			   struct fan_regs_shadow_t *rpm_shadow,
+			   const u8 *pwm_data, bool write_rpm);
+
+static void write_fan_regs_shadowed(struct fan_regs_shadow_t *shadow, const u8 *regs)
+{
+	int first, last;
+
+	mutex_lock(&fan_regs_shadow_lock);
+
+	if (!shadow->valid) {
+		nb05_write_ec_range(shadow->base, regs, FAN_CURVE_POINTS);
+		goto out;
+	}
+
+	// Write each run of changed slots, skip unchanged ones
+	for (first = 0; first < FAN_CURVE_POINTS; first = last) {
+		if (shadow->regs[first] == regs[first]) {
+			last = first + 1;
+			continue;
+		}
+		for (last = first + 1; last < FAN_CURVE_POINTS; ++last)
+			if (shadow->regs[last] == regs[last])
+				break;
+		nb05_write_ec_range(shadow->base + first, regs + first, last - first);
+	}
+
+out:
+	memcpy(shadow->regs, regs, FAN_CURVE_POINTS);
+	shadow->valid = true;
+	mutex_unlock(&fan_regs_shadow_lock);
+}
+
+static void invalidate_fan_regs_shadows(void)
+{
+	mutex_lock(&fan_regs_shadow_lock);
+	fan1_duty_shadow.valid = false;
+	fan1_rpm_shadow.valid = false;
+	fan2_duty_shadow.valid = false;
+	fan2_rpm_shadow.valid = false;
+	mutex_unlock(&fan_regs_shadow_lock);
+}
 
 static int write_fan1_rpm(u8 rpm_data)
 {
-	int reg;
+	u8 regs[FAN_CURVE_POINTS];
+	int i;
 
 	if (rpm_data > FAN_SET_RPM_MAX)
 		return -EINVAL;
@@ -100,14 +183,16 @@ static int write_fan1_rpm(u8 rpm_data)
 	else if (rpm_data < FAN_ON_MIN_SPEED_PERCENT * FAN_SET_RPM_MAX / 100)
 		rpm_data = FAN_ON_MIN_SPEED_PERCENT * FAN_SET_RPM_MAX / 100;
 
-	for (reg = 0x02d0; reg <= 0x02d6; ++reg)
-		nb05_write_ec_ram(reg, rpm_data);
+	for (i = 0; i < 7; ++i)
+		regs[i] = rpm_data;
 
 	if (rpm_data < FAN_SET_RPM_HIGHTEMP)
 		rpm_data = FAN_SET_RPM_HIGHTEMP;
 
-	nb05_write_ec_ram(0x02d7, rpm_data);
-	nb05_write_ec_ram(0x02d8, rpm_data);
+	regs[7] = rpm_data;
+	regs[8] = rpm_data;
+
+	write_fan_regs_shadowed(&fan1_rpm_shadow, regs);
 
 	return 0;
 }
@@ -128,7 +213,8 @@ static u8 read_fan1_duty_onereg(void)
 
 static int write_fan1_duty_ranges(u8 duty_data)
 {
-	int reg;
+	u8 regs[FAN_CURVE_POINTS];
+	int i;
 
 	if (duty_data > FAN_SET_DUTY_MAX)
 		return -EINVAL;
@@ -139,14 +225,16 @@ static int write_fan1_duty_ranges(u8 duty_data)
 	else if (duty_data < FAN_ON_MIN_SPEED_PERCENT * FAN_SET_DUTY_MAX / 100)
 		duty_data = FAN_ON_MIN_SPEED_PERCENT * FAN_SET_DUTY_MAX / 100;
 
-	for (reg = 0x02c1; reg <= 0x02c7; ++reg)
-		nb05_write_ec_ram(reg, duty_data);
+	for (i = 0; i < 7; ++i)
+		regs[i] = duty_data;
 
 	if (duty_data < FAN_SET_DUTY_HIGHTEMP)
 		duty_data = FAN_SET_DUTY_HIGHTEMP;
 
-	nb05_write_ec_ram(0x02c8, duty_data);
-	nb05_write_ec_ram(0x02c9, duty_data);
+	regs[7] = duty_data;
+	regs[8] = duty_data;
+
+	write_fan_regs_shadowed(&fan1_duty_shadow, regs);
 
 	return 0;
 }
@@ -184,6 +272,7 @@ static bool read_fan1_enable_onereg(void)
 static int write_fan1_enable_ranges(bool enable)
 {
 	u8 enable_data = enable ? 1 : 0;
+	invalidate_fan_regs_shadows();
 	nb05_write_ec_ram(0x2c0, enable_data);
 	return 0;
 }
@@ -197,7 +286,8 @@ static int write_fan1_enable_onereg(bool enable)
 
 static int write_fan2_rpm(u8 rpm_data)
 {
-	int reg;
+	u8 regs[FAN_CURVE_POINTS];
+	int i;
 
 	if (rpm_data > FAN_SET_RPM_MAX)
 		return -EINVAL;
@@ -208,14 +298,16 @@ static int write_fan2_rpm(u8 rpm_data)
 	else if (rpm_data < FAN_ON_MIN_SPEED_PERCENT * FAN_SET_RPM_MAX / 100)
 		rpm_data = FAN_ON_MIN_SPEED_PERCENT * FAN_SET_RPM_MAX / 100;
 
-	for (reg = 0x0250; reg <= 0x0256; ++reg)
-		nb05_write_ec_ram(reg, rpm_data);
+	for (i = 0; i < 7; ++i)
+		regs[i] = rpm_data;
 
 	if (rpm_data < FAN_SET_RPM_HIGHTEMP)
 		rpm_data = FAN_SET_RPM_HIGHTEMP;
 
-	nb05_write_ec_ram(0x0257, rpm_data);
-	nb05_write_ec_ram(0x0258, rpm_data);
+	regs[7] = rpm_data;
+	regs[8] = rpm_data;
+
+	write_fan_regs_shadowed(&fan2_rpm_shadow, regs);
 
 	return 0;
 }
@@ -229,7 +321,8 @@ static u8 read_fan2_duty(void)
 
 static int write_fan2_duty(u8 duty_data)
 {
-	int reg;
+	u8 regs[FAN_CURVE_POINTS];
+	int i;
 
 	if (duty_data > FAN_SET_DUTY_MAX)
 		return -EINVAL;
@@ -240,14 +333,16 @@ static int write_fan2_duty(u8 duty_data)
 	else if (duty_data < FAN_ON_MIN_SPEED_PERCENT * FAN_SET_DUTY_MAX / 100)
 		duty_data = FAN_ON_MIN_SPEED_PERCENT * FAN_SET_DUTY_MAX / 100;
 
-	for (reg = 0x0241; reg <= 0x0247; ++reg)
-		nb05_write_ec_ram(reg, duty_data);
+	for (i = 0; i < 7; ++i)
+		regs[i] = duty_data;
 
 	if (duty_data < FAN_SET_DUTY_HIGHTEMP)
 		duty_data = FAN_SET_DUTY_HIGHTEMP;
 
-	nb05_write_ec_ram(0x0248, duty_data);
-	nb05_write_ec_ram(0x0249, duty_data);
+	regs[7] = duty_data;
+	regs[8] = duty_data;
+
+	write_fan_regs_shadowed(&fan2_duty_shadow, regs);
 
 	return 0;
 }
@@ -262,15 +357,60 @@ static bool read_fan2_enable(void)
 static int write_fan2_enable(bool enable)
 {
 	u8 enable_data = enable ? 1 : 0;
+	invalidate_fan_regs_shadows();
 	nb05_write_ec_ram(0x240, enable_data);
 	return 0;
 }
 
+static int write_fan_curve(struct fan_regs_shadow_t *duty_shadow,
+			   struct fan_regs_shadow_t *rpm_shadow,
+			   const u8 *pwm_data, bool write_rpm)
+{
+	u8 duty_regs[FAN_CURVE_POINTS], rpm_regs[FAN_CURVE_POINTS];
+	u8 duty_data, rpm_data;
+	int i;
+
+	for (i = 0; i < FAN_CURVE_POINTS; ++i) {
+		duty_data = PWM_TO_DUTY(pwm_data[i]);
+		rpm_data = PWM_TO_RPM(pwm_data[i]);
+
+		// Don't allow vallues between fan-off and minimum fan-on-speed
+		if (duty_data <= FAN_ON_MIN_SPEED_PERCENT * FAN_SET_DUTY_MAX / 2 / 100)
+			duty_data = 0;
+		else if (duty_data < FAN_ON_MIN_SPEED_PERCENT * FAN_SET_DUTY_MAX / 100)
+			duty_data = FAN_ON_MIN_SPEED_PERCENT * FAN_SET_DUTY_MAX / 100;
+
+		if (rpm_data <= FAN_ON_MIN_SPEED_PERCENT * FAN_SET_RPM_MAX / 2 / 100)
+			rpm_data = 0;
+		else if (rpm_data < FAN_ON_MIN_SPEED_PERCENT * FAN_SET_RPM_MAX / 100)
+			rpm_data = FAN_ON_MIN_SPEED_PERCENT * FAN_SET_RPM_MAX / 100;
+
+		// Same floor for the high temperature ranges as the single value writes
+		if (i >= FAN_CURVE_POINTS - FAN_CURVE_POINTS_HIGHTEMP) {
+			if (duty_data < FAN_SET_DUTY_HIGHTEMP)
+				duty_data = FAN_SET_DUTY_HIGHTEMP;
+			if (rpm_data < FAN_SET_RPM_HIGHTEMP)
+				rpm_data = FAN_SET_RPM_HIGHTEMP;
+		}
+
+		duty_regs[i] = duty_data;
+		rpm_regs[i] = rpm_data;
+	}
+
+	write_fan_regs_shadowed(duty_shadow, duty_regs);
+	if (write_rpm)
+		write_fan_regs_shadowed(rpm_shadow, rpm_regs);
+
+	return 0;
+}
+
 struct fan_control_attrs_t {
 	struct device_attribute fan1_pwm;
 	struct device_attribute fan1_pwm_enable;
 	struct device_attribute fan2_pwm;
 	struct device_attribute fan2_pwm_enable;
+	struct device_attribute fan1_curve;
+	struct device_attribute fan2_curve;
 };
 
 struct fan_control_attrs_t fan_control_attrs = {
@@ -278,6 +418,8 @@ struct fan_control_attrs_t fan_control_attrs = {
 	.fan1_pwm_enable = __ATTR(fan1_pwm_enable, 0644, fan1_pwm_enable_show, fan1_pwm_enable_store),
 	.fan2_pwm = __ATTR(fan2_pwm, 0644, fan2_pwm_show, fan2_pwm_store),
 	.fan2_pwm_enable = __ATTR(fan2_pwm_enable, 0644, fan2_pwm_enable_show, fan2_pwm_enable_store),
+	.fan1_curve = __ATTR(fan1_curve, 0644, fan_curve_show, fan_curve_store),
+	.fan2_curve = __ATTR(fan2_curve, 0644, fan_curve_show, fan_curve_store),
 };
 
 static struct attribute *fan_control_attrs_list[] = {
@@ -285,6 +427,8 @@ static struct attribute *fan_control_attrs_list[] = {
 	&fan_control_attrs.fan1_pwm_enable.attr,
 	&fan_control_attrs.fan2_pwm.attr,
 	&fan_control_attrs.fan2_pwm_enable.attr,
+	&fan_control_attrs.fan1_curve.attr,
+	&fan_control_attrs.fan2_curve.attr,
 	NULL
 };
 
@@ -293,9 +437,16 @@ static umode_t fan_control_attr_is_visible(struct kobject *kobj,
 {
 	struct device *dev = kobj_to_dev(kobj);
 	struct driver_data_t *driver_data = dev_get_drvdata(dev);
+	int number_fans = driver_data->ec_data->dev_data->number_fans;
+
+	// Curves need the range registers, not there on one register fan control
+	if (a == &fan_control_attrs.fan1_curve.attr)
+		return driver_data->ec_data->dev_data->fanctl_onereg ? 0 : 0644;
+	if (a == &fan_control_attrs.fan2_curve.attr)
+		return number_fans >= 2 ? 0644 : 0;
 
 	// Two attributes per fan, show interface for device specific number of fans
-	if (n < (driver_data->ec_data->dev_data->number_fans * 2))
+	if (n < (number_fans * 2))
 		return 0644;
 	else
 		return 0;
@@ -481,6 +632,72 @@ static ssize_t fan2_pwm_enable_store(struct device *dev,
 	return size;
 }
 
+static ssize_t fan_curve_show(struct device *dev,
+			      struct device_attribute *attr, char *buffer)
+{
+	u8 duty_regs[FAN_CURVE_POINTS];
+	u16 duty_base;
+	int i, len = 0;
+
+	if (attr == &fan_control_attrs.fan1_curve)
+		duty_base = FAN1_DUTY_RANGES_BASE;
+	else
+		duty_base = FAN2_DUTY_RANGES_BASE;
+
+	nb05_read_ec_range(duty_base, duty_regs, FAN_CURVE_POINTS);
+
+	for (i = 0; i < FAN_CURVE_POINTS; ++i)
+		len += sysfs_emit_at(buffer, len, "%s%d", i ? " " : "", DUTY_TO_PWM(duty_regs[i]));
+	len += sysfs_emit_at(buffer, len, "\n");
+
+	return len;
+}
+
+/*
+ * Expects FAN_CURVE_POINTS pwm values (0 - 255) separated by spaces, from
+ * the lowest to the highest temperature range
+ */
+static ssize_t fan_curve_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buffer, size_t size)
+{
+	struct driver_data_t *driver_data = dev_get_drvdata(dev);
+	u8 pwm_data[FAN_CURVE_POINTS];
+	char *buffer_copy, *cursor, *token;
+	int err = 0, n = 0;
+
+	buffer_copy = kstrndup(buffer, size, GFP_KERNEL);
+	if (!buffer_copy)
+		return -ENOMEM;
+
+	cursor = strim(buffer_copy);
+	while ((token = strsep(&cursor, " \t")) != NULL) {
+		if (*token == '\0')
+			continue;
+		if (n >= FAN_CURVE_POINTS || kstrtou8(token, 0, &pwm_data[n])) {
+			err = -EINVAL;
+			break;
+		}
+		++n;
+	}
+	kfree(buffer_copy);
+
+	if (err || n != FAN_CURVE_POINTS)
+		return -EINVAL;
+
+	if (attr == &fan_control_attrs.fan1_curve)
+		err = write_fan_curve(&fan1_duty_shadow, &fan1_rpm_shadow,
+				      pwm_data, driver_data->write_rpm);
+	else
+		err = write_fan_curve(&fan2_duty_shadow, &fan2_rpm_shadow,
+				      pwm_data, driver_data->write_rpm);
+
+	if (err)
+		return err;
+
+	return size;
+}
+
 static int __init tuxedo_nb05_fan_control_probe(struct platform_device *pdev)
 {
 	int err;
@@ -529,9 +746,24 @@ static void tuxedo_nb05_fan_control_remove(struct platform_device *pdev)
 #endif
 }
 
+#ifdef CONFIG_PM
+static int driver_resume_callb(struct device *dev)
+{
+	pr_debug("driver resume\n");
+	// EC state is not guaranteed to survive sleep, rewrite everything next time
+	invalidate_fan_regs_shadows();
+	return 0;
+}
+
+static SIMPLE_DEV_PM_OPS(tuxedo_nb05_fan_control_pm_ops, NULL, driver_resume_callb);
+#endif
+
 static struct platform_device *tuxedo_nb05_fan_control_device;
 static struct platform_driver tuxedo_nb05_fan_control_driver = {
 	.driver.name = "tuxedo_fan_control",
+#ifdef CONFIG_PM
+	.driver.pm = &tuxedo_nb05_fan_control_pm_ops,
+#endif
 	.remove = tuxedo_nb05_fan_control_remove,
 };
 
@@ -23,29 +23,39 @@
 #include <linux/hwmon.h>
 #include <linux/platform_device.h>
 #include <linux/dmi.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
 #include "tuxedo_nb05_ec.h"
 
-static int read_cpu_temp(void)
-{
-	u8 cpu_temp;
-	nb05_read_ec_ram(0x470, &cpu_temp);
-	return cpu_temp;
-}
+#define SENSORS_UPDATE_INTERVAL_DEFAULT_MS 1000
+#define SENSORS_UPDATE_INTERVAL_MAX_MS 60000
 
-static int read_fan1_rpm(void)
-{
-	u8 rpm_low, rpm_high;
-	nb05_read_ec_ram(0x298, &rpm_high);
-	nb05_read_ec_ram(0x298, &rpm_low);
-	return (rpm_high << 8) | rpm_low;
-}
+struct sensors_snapshot_t {
+	int cpu_temp;
+	int fan1_rpm;
+	int fan2_rpm;
+};
+
+// Order matches the decoding in read_sensors_snapshot()
+static const u16 sensors_snapshot_addrs[] = {
+	0x470,		// cpu temp
+	0x298, 0x299,	// fan1 rpm high, low
+	0x218, 0x219,	// fan2 rpm high, low
+};
 
-static int read_fan2_rpm(void)
+/*
+ * Read all sensor values in one pass under one EC lock hold so that the
+ * high and low bytes of the RPM values belong together
+ */
+static void read_sensors_snapshot(struct sensors_snapshot_t *snapshot)
 {
-	u8 rpm_low, rpm_high;
-	nb05_read_ec_ram(0x218, &rpm_high);
-	nb05_read_ec_ram(0x219, &rpm_low);
-	return (rpm_high << 8) | rpm_low;
+	u8 data[ARRAY_SIZE(sensors_snapshot_addrs)];
+
+	nb05_read_ec_ram_multi(sensors_snapshot_addrs, data, ARRAY_SIZE(data));
+
+	snapshot->cpu_temp = data[0];
+	snapshot->fan1_rpm = (data[1] << 8) | data[2];
+	snapshot->fan2_rpm = (data[3] << 8) | data[4];
 }
 
 static const char * const temp_labels[] = {
@@ -61,10 +71,34 @@ struct driver_data_t {
 	int fan_cpu_max;
 	int fan_cpu_min;
 	int number_fans;
+	struct mutex snapshot_lock;
+	struct sensors_snapshot_t snapshot;
+	unsigned long snapshot_jiffies;
+	bool snapshot_valid;
+	long update_interval;
 };
 
 struct driver_data_t driver_data;
 
+/*
+ * Serve all attributes from one cached snapshot, refreshed at most once per
+ * update_interval, so that reading every attribute costs one EC pass
+ */
+static void get_sensors_snapshot(struct driver_data_t *driver_data,
+				 struct sensors_snapshot_t *snapshot)
+{
+	mutex_lock(&driver_data->snapshot_lock);
+	if (!driver_data->snapshot_valid ||
+	    time_after(jiffies, driver_data->snapshot_jiffies +
+			       msecs_to_jiffies(driver_data->update_interval))) {
+		read_sensors_snapshot(&driver_data->snapshot);
+		driver_data->snapshot_jiffies = jiffies;
+		driver_data->snapshot_valid = true;
+	}
+	*snapshot = driver_data->snapshot;
+	mutex_unlock(&driver_data->snapshot_lock);
+}
+
 static umode_t
 tuxedo_nb05_hwmon_is_visible(const void *drvdata, enum hwmon_sensor_types type,
 			     u32 attr, int channel)
@@ -72,6 +106,10 @@ tuxedo_nb05_hwmon_is_visible(const void *drvdata, enum hwmon_sensor_types type,
 	struct driver_data_t *driver_data = (struct driver_data_t *) drvdata;
 
 	switch (type) {
+	case hwmon_chip:
+		if (attr == hwmon_chip_update_interval)
+			return 0644;
+		break;
 	case hwmon_temp:
 		return 0444;
 	case hwmon_fan:
@@ -90,10 +128,18 @@ tuxedo_nb05_hwmon_read(struct device *dev, enum hwmon_sensor_types type,
 		       u32 attr, int channel, long *val)
 {
 	struct driver_data_t *driver_data = dev_get_drvdata(dev);
+	struct sensors_snapshot_t snapshot;
 
 	switch (type) {
+	case hwmon_chip:
+		if (attr == hwmon_chip_update_interval) {
+			*val = driver_data->update_interval;
+			return 0;
+		}
+		break;
 	case hwmon_temp:
-		*val = read_cpu_temp() * 1000;
+		get_sensors_snapshot(driver_data, &snapshot);
+		*val = snapshot.cpu_temp * 1000;
 		return 0;
 	case hwmon_fan:
 		switch (attr) {
@@ -116,11 +162,12 @@ tuxedo_nb05_hwmon_read(struct device *dev, enum hwmon_sensor_types type,
 			}
 			break;
 		case hwmon_fan_input:
+			get_sensors_snapshot(driver_data, &snapshot);
 			if (channel == 0) {
-				*val = read_fan1_rpm();
+				*val = snapshot.fan1_rpm;
 				return 0;
 			} else if (channel == 1) {
-				*val = read_fan2_rpm();
+				*val = snapshot.fan2_rpm;
 				return 0;
 			}
 		default:
@@ -133,6 +180,22 @@ tuxedo_nb05_hwmon_read(struct device *dev, enum hwmon_sensor_types type,
 	return -EOPNOTSUPP;
 }
 
+static int
+tuxedo_nb05_hwmon_write(struct device *dev, enum hwmon_sensor_types type,
+			u32 attr, int channel, long val)
+{
+	struct driver_data_t *driver_data = dev_get_drvdata(dev);
+
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval) {
+		mutex_lock(&driver_data->snapshot_lock);
+		driver_data->update_interval = clamp_val(val, 0, SENSORS_UPDATE_INTERVAL_MAX_MS);
+		mutex_unlock(&driver_data->snapshot_lock);
+		return 0;
+	}
+
+	return -EOPNOTSUPP;
+}
+
 static int
 tuxedo_nb05_hwmon_read_string(struct device *dev, enum hwmon_sensor_types type,
 			      u32 attr, int channel, const char **str)
@@ -154,10 +217,13 @@ tuxedo_nb05_hwmon_read_string(struct device *dev, enum hwmon_sensor_types type,
 static const struct hwmon_ops tuxedo_nb05_hwmon_ops = {
 	.is_visible = tuxedo_nb05_hwmon_is_visible,
 	.read = tuxedo_nb05_hwmon_read,
+	.write = tuxedo_nb05_hwmon_write,
 	.read_string = tuxedo_nb05_hwmon_read_string
 };
 
 static const struct hwmon_channel_info *const tuxedo_nb05_hwmon_info[] = {
+	HWMON_CHANNEL_INFO(chip,
+			   HWMON_C_UPDATE_INTERVAL),
 	HWMON_CHANNEL_INFO(temp,
 			   HWMON_T_INPUT | HWMON_T_LABEL),
 	HWMON_CHANNEL_INFO(fan,
@@ -182,6 +248,9 @@ static int __init tuxedo_nb05_sensors_probe(struct platform_device *pdev) {
 		return -ENODEV;
 
 	driver_data.fan_cpu_min = 0;
+	mutex_init(&driver_data.snapshot_lock);
+	driver_data.snapshot_valid = false;
+	driver_data.update_interval = SENSORS_UPDATE_INTERVAL_DEFAULT_MS;
 
 	if (!strcmp(sysid->ident, IFLX14I01)) {
 		driver_data.number_fans = 1;
@@ -23,8 +23,12 @@
 #include <linux/module.h>
 #include <linux/acpi.h>
 #include <linux/version.h>
+#include <linux/ktime.h>
 #include "tuxi_acpi.h"
 
+#define CREATE_TRACE_POINTS
+#include "tuxi_acpi_trace.h"
+
 #define DRIVER_NAME "tuxi_acpi"
 
 struct tuxi_acpi_driver_data_t {
@@ -54,10 +58,13 @@ int evaluate_intparams(acpi_handle handle,
 	acpi_status status;
 	int i;
 	u32 param_buffer_size = sizeof(union acpi_object) * param_count;
+	u64 start_ns;
 
 	if (!handle)
 		return -ENODEV;
 
+	start_ns = ktime_get_ns();
+
 	if (param_buffer_size > 0)
 		params = kzalloc(param_buffer_size, GFP_KERNEL);
 
@@ -76,6 +83,10 @@ int evaluate_intparams(acpi_handle handle,
 		status = acpi_evaluate_integer(handle, pathname, NULL, &result);
 	}
 
+	trace_tuxi_evaluate_intparams(pathname, param_count, param_count > 0 ? int_params[0] : 0,
+				      ACPI_FAILURE(status) ? 0 : result, ktime_get_ns() - start_ns,
+				      ACPI_FAILURE(status) ? -EIO : 0);
+
 	if (ACPI_FAILURE(status))
 		return -EIO;
 
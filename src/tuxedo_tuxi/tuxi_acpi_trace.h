@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*!
+ * Copyright (c) 2025 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-drivers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tuxedo_tuxi
+
+#if !defined(TUXI_ACPI_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define TUXI_ACPI_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * Integer method evaluation, param0 is the first parameter if any
+ */
+TRACE_EVENT(tuxi_evaluate_intparams,
+
+	TP_PROTO(const char *pathname, u32 param_count, unsigned long long param0,
+		 unsigned long long retval, u64 duration_ns, int status),
+
+	TP_ARGS(pathname, param_count, param0, retval, duration_ns, status),
+
+	TP_STRUCT__entry(
+		__array(char, pathname, 8)
+		__field(u32, param_count)
+		__field(unsigned long long, param0)
+		__field(unsigned long long, retval)
+		__field(u64, duration_ns)
+		__field(int, status)
+	),
+
+	TP_fast_assign(
+		strscpy(__entry->pathname, pathname, sizeof(__entry->pathname));
+		__entry->param_count = param_count;
+		__entry->param0 = param0;
+		__entry->retval = retval;
+		__entry->duration_ns = duration_ns;
+		__entry->status = status;
+	),
+
+	TP_printk("method=%s params=%u param0=%llu retval=%llu duration_ns=%llu status=%d",
+		  __entry->pathname, __entry->param_count, __entry->param0,
+		  __entry->retval, __entry->duration_ns, __entry->status)
+);
+
+#endif // TUXI_ACPI_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE tuxi_acpi_trace
+#include <trace/define_trace.h>
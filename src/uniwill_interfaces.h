@@ -22,6 +22,7 @@
 #define UNIWILL_INTERFACES_H
 
 #include <linux/types.h>
+#include <linux/notifier.h>
 
 #define UNIWILL_WMI_MGMT_GUID_BA	"ABBC0F6D-8EA1-11D1-00A0-C90629100000"
 #define UNIWILL_WMI_MGMT_GUID_BB	"ABBC0F6E-8EA1-11D1-00A0-C90629100000"
@@ -43,10 +44,17 @@
 	MODULE_ALIAS("wmi:" UNIWILL_WMI_MGMT_GUID_BC);
 
 #define UNIWILL_INTERFACE_WMI_STRID "uniwill_wmi"
+#define UNIWILL_INTERFACE_SIM_STRID "uniwill_sim"
+
+// Event codes delivered through event_callb and the event notifier chain
+#define UNIWILL_OSD_DC_ADAPTER_CHANGE			0x0AB
 
 typedef int (uniwill_read_ec_ram_t)(u16, u8*);
 typedef int (uniwill_read_ec_ram_with_retry_t)(u16, u8*, int);
 typedef int (uniwill_write_ec_ram_t)(u16, u8);
+typedef int (uniwill_read_ec_ram_bulk_t)(u16, u8*, u16);
+typedef int (uniwill_read_ec_ram_multi_t)(const u16*, u8*, u16);
+typedef int (uniwill_write_ec_ram_bulk_t)(u16, const u8*, u16);
 typedef int (uniwill_wmi_evaluate_t)(u8 function, u32 arg, u32 *return_buffer);
 typedef int (uniwill_write_ec_ram_with_retry_t)(u16, u8, int);
 typedef void (uniwill_event_callb_t)(u32);
@@ -90,6 +98,10 @@ typedef void (uniwill_event_callb_t)(u32);
 #define UW_EC_REG_FAN_CTRL_STATUS			0x078e
 #define UW_EC_REG_FAN_CTRL_STATUS_BIT_HAS_UW_FAN_CTRL	0x40
 
+// Custom fan tables, end temp, start temp and speed for cpu then gpu fan
+#define UW_EC_REG_CUSTOM_FAN_TABLES			0x0f00
+#define UW_EC_REG_CUSTOM_FAN_TABLES_LEN			0x60
+
 #define UW_EC_REG_CTGP_DB_ENABLE			0x0743
 #define UW_EC_REG_CTGP_DB_ENABLE_BIT_GENERAL_ENABLE	0x01
 #define UW_EC_REG_CTGP_DB_ENABLE_BIT_DB_ENABLE		0x02
@@ -123,6 +135,11 @@ struct uniwill_interface_t {
 	uniwill_event_callb_t *event_callb;
 	uniwill_read_ec_ram_t *read_ec_ram;
 	uniwill_write_ec_ram_t *write_ec_ram;
+	// Optional, contiguous range access under a single lock hold
+	uniwill_read_ec_ram_bulk_t *read_ec_ram_bulk;
+	uniwill_write_ec_ram_bulk_t *write_ec_ram_bulk;
+	// Optional, scattered addresses under a single lock hold
+	uniwill_read_ec_ram_multi_t *read_ec_ram_multi;
 	uniwill_wmi_evaluate_t *wmi_evaluate;
 };
 
@@ -130,10 +147,28 @@ int uniwill_add_interface(struct uniwill_interface_t *new_interface);
 int uniwill_remove_interface(struct uniwill_interface_t *interface);
 uniwill_read_ec_ram_t uniwill_read_ec_ram;
 uniwill_write_ec_ram_t uniwill_write_ec_ram;
+uniwill_read_ec_ram_bulk_t uniwill_read_ec_ram_bulk;
+uniwill_write_ec_ram_bulk_t uniwill_write_ec_ram_bulk;
+uniwill_read_ec_ram_multi_t uniwill_read_ec_ram_multi;
 uniwill_wmi_evaluate_t uniwill_wmi_evaluate;
 uniwill_write_ec_ram_with_retry_t uniwill_write_ec_ram_with_retry;
 uniwill_read_ec_ram_with_retry_t uniwill_read_ec_ram_with_retry;
 int uniwill_get_active_interface_id(char **id_str);
+// Notified with the raw event code as action, from atomic context
+int uniwill_register_event_notifier(struct notifier_block *nb);
+int uniwill_unregister_event_notifier(struct notifier_block *nb);
+
+/*
+ * Queued EC access, executed in order on a dedicated workqueue. Writes are
+ * fire-and-forget unless wait is set, in which case the EC status is returned.
+ * Pending async writes to the same address are merged. Calls run a whole
+ * state replay (LED, charging) in queue order.
+ */
+typedef void (uniwill_ec_queue_fn_t)(void);
+int uniwill_write_ec_ram_queued(u16 address, u8 data, bool wait);
+int uniwill_write_ec_ram_async(u16 address, u8 data);
+int uniwill_ec_queue_call(uniwill_ec_queue_fn_t *fn);
+void uniwill_ec_queue_flush(void);
 
 #define UW_MODEL_PF5LUXG	0x09
 #define UW_MODEL_PH4TUX		0x13
@@ -204,4 +239,21 @@ int uw_init_fan(void);
 u32 uw_set_fan(u32 fan_index, u8 fan_speed);
 u32 uw_set_fan_auto(void);
 
+/*
+ * Fan curve for the EC fan tables (universal EC fan control only). Point i
+ * sets speed[i] (0 - NB02_FAN_SPEED_MAX) from temp[i] up to temp[i + 1].
+ * Temperatures have to be strictly increasing and below
+ * UW_FAN_CURVE_TEMP_MAX, temp[0] has to be 0 °C.
+ */
+#define UW_FAN_CURVE_MAX_POINTS	16
+#define UW_FAN_CURVE_TEMP_MAX	115
+
+struct uniwill_fan_curve_t {
+	u8 num_points;
+	u8 temp[UW_FAN_CURVE_MAX_POINTS];
+	u8 speed[UW_FAN_CURVE_MAX_POINTS];
+};
+
+int uw_set_fan_curve(u32 fan_index, const struct uniwill_fan_curve_t *curve);
+
 #endif
@@ -36,6 +36,8 @@
 #include <linux/slab.h>
 #include <linux/i8042.h>
 #include <linux/serio.h>
+#include <linux/debugfs.h>
+#include <linux/notifier.h>
 #include <acpi/battery.h>
 #include "uniwill_interfaces.h"
 #include "uniwill_leds.h"
@@ -49,7 +51,6 @@
 #define UNIWILL_OSD_KB_LED_LEVEL2			0x03D
 #define UNIWILL_OSD_KB_LED_LEVEL3			0x03E
 #define UNIWILL_OSD_KB_LED_LEVEL4			0x03F
-#define UNIWILL_OSD_DC_ADAPTER_CHANGE			0x0AB
 #define UNIWILL_OSD_MODE_CHANGE_KEY_EVENT		0x0B0
 
 #define UNIWILL_KEY_RFKILL				0x0A4
@@ -110,7 +111,445 @@ static struct uniwill_interfaces_t {
 
 uniwill_event_callb_t uniwill_event_callb;
 
-int uniwill_read_ec_ram(u16 address, u8 *data)
+/*
+ * Shadow cache for EC RAM registers
+ *
+ * STATIC:        Never changes at runtime, served from memory after the first
+ *                successful read. A write drops the cached value.
+ * WRITE_THROUGH: Only changed by this driver, cached on read and updated on
+ *                successful writes.
+ * Everything not listed is VOLATILE and always read from the EC.
+ *
+ * The shadow is dropped on resume and on AC adapter changes since the EC may
+ * reinitialize its state in both cases.
+ */
+enum uw_ec_shadow_class {
+	UW_EC_SHADOW_VOLATILE = 0,
+	UW_EC_SHADOW_STATIC,
+	UW_EC_SHADOW_WRITE_THROUGH,
+};
+
+struct uw_ec_shadow_range_t {
+	u16 address;
+	u8 length;
+	enum uw_ec_shadow_class class;
+};
+
+static const struct uw_ec_shadow_range_t uw_ec_shadow_ranges[] = {
+	{ UW_EC_REG_BAREBONE_ID,			1,	UW_EC_SHADOW_STATIC },
+	{ UW_EC_REG_FEATURES_0,				2,	UW_EC_SHADOW_STATIC },
+	{ UW_EC_REG_ROMID_START,			16,	UW_EC_SHADOW_WRITE_THROUGH },
+	{ UW_EC_REG_FAN_CTRL_STATUS,			1,	UW_EC_SHADOW_STATIC },
+	{ UW_EC_REG_MINI_LED_LOCAL_DIMMING_SUPPORT,	1,	UW_EC_SHADOW_STATIC },
+	{ UW_EC_REG_CUSTOM_FAN_TABLES,			UW_EC_REG_CUSTOM_FAN_TABLES_LEN,
+							UW_EC_SHADOW_WRITE_THROUGH },
+};
+
+// Sum of the range lengths above, checked in uw_ec_shadow_slot()
+#define UW_EC_SHADOW_SLOTS (21 + UW_EC_REG_CUSTOM_FAN_TABLES_LEN)
+
+static DEFINE_MUTEX(uw_ec_shadow_lock);
+static u8 uw_ec_shadow_values[UW_EC_SHADOW_SLOTS];
+static DECLARE_BITMAP(uw_ec_shadow_valid, UW_EC_SHADOW_SLOTS);
+static u64 uw_ec_shadow_hits;
+static u64 uw_ec_shadow_misses;
+
+/**
+ * Get shadow slot and class for an address, returns -1 for volatile addresses
+ */
+static int uw_ec_shadow_slot(u16 address, enum uw_ec_shadow_class *class)
+{
+	int i, slot = 0;
+
+	for (i = 0; i < ARRAY_SIZE(uw_ec_shadow_ranges); ++i) {
+		const struct uw_ec_shadow_range_t *range = &uw_ec_shadow_ranges[i];
+		if (address >= range->address && address < range->address + range->length) {
+			// Ranges beyond UW_EC_SHADOW_SLOTS stay volatile
+			if (WARN_ONCE(slot + range->length > UW_EC_SHADOW_SLOTS,
+				      "uniwill: ec shadow range 0x%04x exceeds UW_EC_SHADOW_SLOTS\n",
+				      range->address))
+				return -1;
+			if (class)
+				*class = range->class;
+			return slot + (address - range->address);
+		}
+		slot += range->length;
+	}
+
+	return -1;
+}
+
+static bool uw_ec_shadow_range_cached(u16 address, u16 len)
+{
+	u16 i;
+
+	for (i = 0; i < len; ++i)
+		if (uw_ec_shadow_slot(address + i, NULL) >= 0)
+			return true;
+
+	return false;
+}
+
+static void uw_ec_shadow_store(u16 address, u8 data, bool written)
+{
+	enum uw_ec_shadow_class class;
+	int slot = uw_ec_shadow_slot(address, &class);
+
+	if (slot < 0)
+		return;
+
+	if (written && class == UW_EC_SHADOW_STATIC) {
+		clear_bit(slot, uw_ec_shadow_valid);
+		return;
+	}
+
+	uw_ec_shadow_values[slot] = data;
+	set_bit(slot, uw_ec_shadow_valid);
+}
+
+static void uw_ec_shadow_drop(u16 address)
+{
+	int slot = uw_ec_shadow_slot(address, NULL);
+
+	if (slot >= 0)
+		clear_bit(slot, uw_ec_shadow_valid);
+}
+
+static bool uw_ec_shadow_lookup(u16 address, u8 *data)
+{
+	int slot = uw_ec_shadow_slot(address, NULL);
+
+	if (slot < 0 || !test_bit(slot, uw_ec_shadow_valid))
+		return false;
+
+	*data = uw_ec_shadow_values[slot];
+	return true;
+}
+
+/*
+ * Queued EC engine
+ *
+ * Every EC access costs several milliseconds and is serialized by the
+ * interface lock. Latency insensitive writers (LED updates, state replays on
+ * resume or AC change) hand their requests to an ordered workqueue instead of
+ * blocking in their own, possibly atomic, context. Readers stay synchronous
+ * but drain the queue first when a pending request could touch their data.
+ */
+enum uw_ec_request_type {
+	UW_EC_REQUEST_WRITE,
+	UW_EC_REQUEST_CALL,
+};
+
+struct uw_ec_request_t {
+	struct list_head list;
+	enum uw_ec_request_type type;
+	u16 address;
+	u8 data;
+	uniwill_ec_queue_fn_t *fn;
+	bool async;
+	int status;
+	struct completion done;
+};
+
+static struct workqueue_struct *uw_ec_queue_wq;
+static LIST_HEAD(uw_ec_queue);
+static DEFINE_SPINLOCK(uw_ec_queue_lock);
+static struct uw_ec_request_t *uw_ec_queue_inflight;
+static struct task_struct *uw_ec_queue_worker;
+static u64 uw_ec_queue_submitted;
+static u64 uw_ec_queue_merged;
+
+static void uw_ec_queue_work_handler(struct work_struct *work)
+{
+	struct uw_ec_request_t *req;
+	unsigned long flags;
+
+	uw_ec_queue_worker = current;
+
+	for (;;) {
+		spin_lock_irqsave(&uw_ec_queue_lock, flags);
+		req = list_first_entry_or_null(&uw_ec_queue, struct uw_ec_request_t, list);
+		if (req)
+			list_del_init(&req->list);
+		uw_ec_queue_inflight = req;
+		spin_unlock_irqrestore(&uw_ec_queue_lock, flags);
+
+		if (!req)
+			break;
+
+		if (req->type == UW_EC_REQUEST_CALL) {
+			req->fn();
+			req->status = 0;
+		} else {
+			req->status = uniwill_write_ec_ram(req->address, req->data);
+			if (req->status)
+				pr_debug("queued write 0x%04x failed (%d)\n", req->address, req->status);
+		}
+
+		spin_lock_irqsave(&uw_ec_queue_lock, flags);
+		uw_ec_queue_inflight = NULL;
+		spin_unlock_irqrestore(&uw_ec_queue_lock, flags);
+
+		if (req->async)
+			kfree(req);
+		else
+			complete(&req->done);
+	}
+
+	uw_ec_queue_worker = NULL;
+}
+static DECLARE_WORK(uw_ec_queue_work, uw_ec_queue_work_handler);
+
+/**
+ * Queue is bypassed before probe, after remove and from within the worker
+ * itself (state replays issuing their own writes)
+ */
+static bool uw_ec_queue_bypass(void)
+{
+	return !uw_ec_queue_wq || uw_ec_queue_worker == current;
+}
+
+static bool uw_ec_request_touches(struct uw_ec_request_t *req, u16 address, u16 len)
+{
+	if (req->type == UW_EC_REQUEST_CALL)
+		return true;
+
+	return req->address >= address && req->address < address + len;
+}
+
+/**
+ * Check if any queued or running request may modify the given range. Calls
+ * replay arbitrary state and are therefore considered to touch everything.
+ */
+static bool uw_ec_queue_pending(u16 address, u16 len)
+{
+	struct uw_ec_request_t *req;
+	unsigned long flags;
+	bool pending = false;
+
+	spin_lock_irqsave(&uw_ec_queue_lock, flags);
+	if (uw_ec_queue_inflight && uw_ec_request_touches(uw_ec_queue_inflight, address, len))
+		pending = true;
+	list_for_each_entry(req, &uw_ec_queue, list) {
+		if (pending)
+			break;
+		pending = uw_ec_request_touches(req, address, len);
+	}
+	spin_unlock_irqrestore(&uw_ec_queue_lock, flags);
+
+	return pending;
+}
+
+void uniwill_ec_queue_flush(void)
+{
+	if (uw_ec_queue_bypass())
+		return;
+
+	flush_work(&uw_ec_queue_work);
+}
+EXPORT_SYMBOL(uniwill_ec_queue_flush);
+
+/*
+ * Raw WMI events are passed on to other modules (tuxedo_io) before being
+ * handled here. Called from the WMI notify context, callbacks must not sleep.
+ */
+static ATOMIC_NOTIFIER_HEAD(uniwill_event_notifier);
+
+int uniwill_register_event_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&uniwill_event_notifier, nb);
+}
+EXPORT_SYMBOL(uniwill_register_event_notifier);
+
+int uniwill_unregister_event_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&uniwill_event_notifier, nb);
+}
+EXPORT_SYMBOL(uniwill_unregister_event_notifier);
+
+static void uw_ec_queue_flush_range(u16 address, u16 len)
+{
+	if (!uw_ec_queue_bypass() && uw_ec_queue_pending(address, len))
+		flush_work(&uw_ec_queue_work);
+}
+
+/**
+ * Merge an async write into the latest pending async write to the same
+ * address. Only done if no call or synchronous write to that address sits
+ * in between, so the observable write order stays the same.
+ */
+static bool uw_ec_queue_merge(u16 address, u8 data)
+{
+	struct uw_ec_request_t *req;
+
+	list_for_each_entry_reverse(req, &uw_ec_queue, list) {
+		if (req->type == UW_EC_REQUEST_CALL)
+			return false;
+		if (req->address == address) {
+			if (!req->async)
+				return false;
+			req->data = data;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int uniwill_write_ec_ram_queued(u16 address, u8 data, bool wait)
+{
+	struct uw_ec_request_t sync_req, *req;
+	unsigned long flags;
+
+	if (uw_ec_queue_bypass())
+		return uniwill_write_ec_ram(address, data);
+
+	if (wait) {
+		req = &sync_req;
+		init_completion(&req->done);
+	} else {
+		req = kzalloc(sizeof(*req), GFP_ATOMIC);
+		if (!req)
+			return -ENOMEM;
+	}
+	req->type = UW_EC_REQUEST_WRITE;
+	req->address = address;
+	req->data = data;
+	req->async = !wait;
+
+	spin_lock_irqsave(&uw_ec_queue_lock, flags);
+	if (!uw_ec_queue_wq) {
+		// Queue removed meanwhile
+		spin_unlock_irqrestore(&uw_ec_queue_lock, flags);
+		if (!wait)
+			kfree(req);
+		return uniwill_write_ec_ram(address, data);
+	}
+	uw_ec_queue_submitted += 1;
+	if (!wait && uw_ec_queue_merge(address, data)) {
+		uw_ec_queue_merged += 1;
+		spin_unlock_irqrestore(&uw_ec_queue_lock, flags);
+		kfree(req);
+		return 0;
+	}
+	list_add_tail(&req->list, &uw_ec_queue);
+	queue_work(uw_ec_queue_wq, &uw_ec_queue_work);
+	spin_unlock_irqrestore(&uw_ec_queue_lock, flags);
+
+	if (!wait)
+		return 0;
+
+	wait_for_completion(&req->done);
+	return req->status;
+}
+EXPORT_SYMBOL(uniwill_write_ec_ram_queued);
+
+int uniwill_write_ec_ram_async(u16 address, u8 data)
+{
+	return uniwill_write_ec_ram_queued(address, data, false);
+}
+EXPORT_SYMBOL(uniwill_write_ec_ram_async);
+
+/**
+ * Queue a state replay function. A replay that is already pending is not
+ * queued twice, it reads the driver state at execution time anyway.
+ */
+int uniwill_ec_queue_call(uniwill_ec_queue_fn_t *fn)
+{
+	struct uw_ec_request_t *req, *pending;
+	unsigned long flags;
+
+	if (uw_ec_queue_bypass()) {
+		fn();
+		return 0;
+	}
+
+	req = kzalloc(sizeof(*req), GFP_ATOMIC);
+	if (!req)
+		return -ENOMEM;
+	req->type = UW_EC_REQUEST_CALL;
+	req->fn = fn;
+	req->async = true;
+
+	spin_lock_irqsave(&uw_ec_queue_lock, flags);
+	if (!uw_ec_queue_wq) {
+		// Queue removed meanwhile
+		spin_unlock_irqrestore(&uw_ec_queue_lock, flags);
+		kfree(req);
+		fn();
+		return 0;
+	}
+	uw_ec_queue_submitted += 1;
+	list_for_each_entry(pending, &uw_ec_queue, list) {
+		if (pending->type == UW_EC_REQUEST_CALL && pending->fn == fn) {
+			uw_ec_queue_merged += 1;
+			spin_unlock_irqrestore(&uw_ec_queue_lock, flags);
+			kfree(req);
+			return 0;
+		}
+	}
+	list_add_tail(&req->list, &uw_ec_queue);
+	queue_work(uw_ec_queue_wq, &uw_ec_queue_work);
+	spin_unlock_irqrestore(&uw_ec_queue_lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(uniwill_ec_queue_call);
+
+static void uw_ec_queue_init(void)
+{
+	uw_ec_queue_wq = alloc_ordered_workqueue("tuxedo_uniwill_ec", 0);
+	if (!uw_ec_queue_wq)
+		pr_warn("could not allocate EC workqueue, falling back to synchronous access\n");
+}
+
+/**
+ * New requests see the cleared pointer under the queue lock and fall back to
+ * synchronous access, everything queued before is flushed
+ */
+static void uw_ec_queue_remove(void)
+{
+	struct workqueue_struct *wq;
+	unsigned long flags;
+
+	spin_lock_irqsave(&uw_ec_queue_lock, flags);
+	wq = uw_ec_queue_wq;
+	uw_ec_queue_wq = NULL;
+	spin_unlock_irqrestore(&uw_ec_queue_lock, flags);
+
+	if (!wq)
+		return;
+
+	flush_work(&uw_ec_queue_work);
+	destroy_workqueue(wq);
+}
+
+static struct dentry *uw_debugfs_dir;
+
+static void uw_debugfs_init(void)
+{
+	uw_debugfs_dir = debugfs_create_dir("tuxedo_uniwill", NULL);
+	debugfs_create_u64("ec_shadow_hits", 0444, uw_debugfs_dir, &uw_ec_shadow_hits);
+	debugfs_create_u64("ec_shadow_misses", 0444, uw_debugfs_dir, &uw_ec_shadow_misses);
+	debugfs_create_u64("ec_queue_submitted", 0444, uw_debugfs_dir, &uw_ec_queue_submitted);
+	debugfs_create_u64("ec_queue_merged", 0444, uw_debugfs_dir, &uw_ec_queue_merged);
+}
+
+static void uw_debugfs_remove(void)
+{
+	debugfs_remove_recursive(uw_debugfs_dir);
+	uw_debugfs_dir = NULL;
+}
+
+static void uniwill_ec_shadow_invalidate(void)
+{
+	mutex_lock(&uw_ec_shadow_lock);
+	bitmap_zero(uw_ec_shadow_valid, UW_EC_SHADOW_SLOTS);
+	mutex_unlock(&uw_ec_shadow_lock);
+	pr_debug("ec shadow invalidated\n");
+}
+
+static int __uniwill_read_ec_ram(u16 address, u8 *data)
 {
 	int status;
 
@@ -123,6 +562,90 @@ int uniwill_read_ec_ram(u16 address, u8 *data)
 
 	return status;
 }
+
+static int __uniwill_write_ec_ram(u16 address, u8 data)
+{
+	int status;
+
+	if (!IS_ERR_OR_NULL(uniwill_interfaces.wmi))
+		status = uniwill_interfaces.wmi->write_ec_ram(address, data);
+	else {
+		pr_err("no active interface while write addr 0x%04x data 0x%02x\n", address, data);
+		status = -EIO;
+	}
+
+	return status;
+}
+
+static int __uniwill_read_ec_ram_bulk(u16 address, u8 *data, u16 len)
+{
+	int status = 0;
+	u16 i;
+
+	if (IS_ERR_OR_NULL(uniwill_interfaces.wmi)) {
+		pr_err("no active interface while bulk read addr 0x%04x len %u\n", address, len);
+		return -EIO;
+	}
+
+	if (!IS_ERR_OR_NULL(uniwill_interfaces.wmi->read_ec_ram_bulk))
+		return uniwill_interfaces.wmi->read_ec_ram_bulk(address, data, len);
+
+	// Fall back to single byte access for interfaces without bulk support
+	for (i = 0; i < len; ++i) {
+		status = uniwill_interfaces.wmi->read_ec_ram(address + i, &data[i]);
+		if (status)
+			break;
+	}
+
+	return status;
+}
+
+static int __uniwill_write_ec_ram_bulk(u16 address, const u8 *data, u16 len)
+{
+	int status = 0;
+	u16 i;
+
+	if (IS_ERR_OR_NULL(uniwill_interfaces.wmi)) {
+		pr_err("no active interface while bulk write addr 0x%04x len %u\n", address, len);
+		return -EIO;
+	}
+
+	if (!IS_ERR_OR_NULL(uniwill_interfaces.wmi->write_ec_ram_bulk))
+		return uniwill_interfaces.wmi->write_ec_ram_bulk(address, data, len);
+
+	// Fall back to single byte access for interfaces without bulk support
+	for (i = 0; i < len; ++i) {
+		status = uniwill_interfaces.wmi->write_ec_ram(address + i, data[i]);
+		if (status)
+			break;
+	}
+
+	return status;
+}
+
+int uniwill_read_ec_ram(u16 address, u8 *data)
+{
+	int status;
+
+	uw_ec_queue_flush_range(address, 1);
+
+	if (uw_ec_shadow_slot(address, NULL) < 0)
+		return __uniwill_read_ec_ram(address, data);
+
+	mutex_lock(&uw_ec_shadow_lock);
+	if (uw_ec_shadow_lookup(address, data)) {
+		uw_ec_shadow_hits += 1;
+		status = 0;
+	} else {
+		uw_ec_shadow_misses += 1;
+		status = __uniwill_read_ec_ram(address, data);
+		if (status == 0)
+			uw_ec_shadow_store(address, *data, false);
+	}
+	mutex_unlock(&uw_ec_shadow_lock);
+
+	return status;
+}
 EXPORT_SYMBOL(uniwill_read_ec_ram);
 
 int uniwill_read_ec_ram_with_retry(u16 address, u8 *data, int retries)
@@ -141,16 +664,77 @@ int uniwill_read_ec_ram_with_retry(u16 address, u8 *data, int retries)
 }
 EXPORT_SYMBOL(uniwill_read_ec_ram_with_retry);
 
-static int uniwill_read_ec_ram_u16(u16 hibyte_address, u16 lobyte_address, u16 *data) {
+int uniwill_read_ec_ram_bulk(u16 address, u8 *data, u16 len)
+{
+	int status;
+	u16 i;
+
+	uw_ec_queue_flush_range(address, len);
+
+	if (!uw_ec_shadow_range_cached(address, len))
+		return __uniwill_read_ec_ram_bulk(address, data, len);
+
+	mutex_lock(&uw_ec_shadow_lock);
+	for (i = 0; i < len; ++i)
+		if (!uw_ec_shadow_lookup(address + i, &data[i]))
+			break;
+
+	if (i == len) {
+		uw_ec_shadow_hits += 1;
+		status = 0;
+	} else {
+		uw_ec_shadow_misses += 1;
+		status = __uniwill_read_ec_ram_bulk(address, data, len);
+		if (status == 0)
+			for (i = 0; i < len; ++i)
+				uw_ec_shadow_store(address + i, data[i], false);
+	}
+	mutex_unlock(&uw_ec_shadow_lock);
+
+	return status;
+}
+EXPORT_SYMBOL(uniwill_read_ec_ram_bulk);
+
+/**
+ * Read a scattered set of addresses, with a single interface lock hold if the
+ * interface supports it. Always reads from the EC, the shadow is not consulted.
+ */
+int uniwill_read_ec_ram_multi(const u16 *addresses, u8 *data, u16 count)
+{
+	int status = 0;
+	u16 i;
+
+	if (IS_ERR_OR_NULL(uniwill_interfaces.wmi)) {
+		pr_err("no active interface while multi read of %u addresses\n", count);
+		return -EIO;
+	}
+
+	for (i = 0; i < count; ++i)
+		uw_ec_queue_flush_range(addresses[i], 1);
+
+	if (!IS_ERR_OR_NULL(uniwill_interfaces.wmi->read_ec_ram_multi))
+		return uniwill_interfaces.wmi->read_ec_ram_multi(addresses, data, count);
+
+	for (i = 0; i < count; ++i) {
+		status = uniwill_interfaces.wmi->read_ec_ram(addresses[i], &data[i]);
+		if (status)
+			break;
+	}
+
+	return status;
+}
+EXPORT_SYMBOL(uniwill_read_ec_ram_multi);
+
+/**
+ * Read little endian u16 stored at lobyte_address and lobyte_address + 1
+ */
+static int uniwill_read_ec_ram_u16(u16 lobyte_address, u16 *data) {
 	int result;
-	u8 hi, lo;
-	result = uniwill_read_ec_ram(hibyte_address, &hi);
+	u8 buf[2];
+	result = uniwill_read_ec_ram_bulk(lobyte_address, buf, sizeof(buf));
 	if (result)
 		return result;
-	result = uniwill_read_ec_ram(lobyte_address, &lo);
-	if (result)
-		return result;
-	*data = (hi << 8) | lo;
+	*data = (buf[1] << 8) | buf[0];
 	return result;
 }
 
@@ -158,17 +742,81 @@ int uniwill_write_ec_ram(u16 address, u8 data)
 {
 	int status;
 
-	if (!IS_ERR_OR_NULL(uniwill_interfaces.wmi))
-		status = uniwill_interfaces.wmi->write_ec_ram(address, data);
-	else {
-		pr_err("no active interface while write addr 0x%04x data 0x%02x\n", address, data);
-		status = -EIO;
-	}
+	uw_ec_queue_flush_range(address, 1);
+
+	if (uw_ec_shadow_slot(address, NULL) < 0)
+		return __uniwill_write_ec_ram(address, data);
+
+	mutex_lock(&uw_ec_shadow_lock);
+	status = __uniwill_write_ec_ram(address, data);
+	if (status == 0)
+		uw_ec_shadow_store(address, data, true);
+	else
+		uw_ec_shadow_drop(address);
+	mutex_unlock(&uw_ec_shadow_lock);
 
 	return status;
 }
 EXPORT_SYMBOL(uniwill_write_ec_ram);
 
+int uniwill_write_ec_ram_bulk(u16 address, const u8 *data, u16 len)
+{
+	int status;
+	u16 i;
+
+	uw_ec_queue_flush_range(address, len);
+
+	if (!uw_ec_shadow_range_cached(address, len))
+		return __uniwill_write_ec_ram_bulk(address, data, len);
+
+	mutex_lock(&uw_ec_shadow_lock);
+	status = __uniwill_write_ec_ram_bulk(address, data, len);
+	for (i = 0; i < len; ++i) {
+		if (status == 0)
+			uw_ec_shadow_store(address + i, data[i], true);
+		else
+			uw_ec_shadow_drop(address + i);
+	}
+	mutex_unlock(&uw_ec_shadow_lock);
+
+	return status;
+}
+EXPORT_SYMBOL(uniwill_write_ec_ram_bulk);
+
+/**
+ * Bulk write followed by a bulk read-back, repeated until the read-back
+ * matches or the retries are exhausted
+ */
+static int uniwill_write_ec_ram_bulk_with_retry(u16 address, const u8 *data, u16 len, int retries)
+{
+	int status = -EIO, i;
+	u8 *control_data;
+
+	control_data = kmalloc(len, GFP_KERNEL);
+	if (!control_data)
+		return -ENOMEM;
+
+	for (i = 0; i < retries; ++i) {
+		status = uniwill_write_ec_ram_bulk(address, data, len);
+		if (status != 0) {
+			msleep(50);
+			continue;
+		}
+		// Verify against the EC, not the shadow
+		status = __uniwill_read_ec_ram_bulk(address, control_data, len);
+		if (status != 0 || memcmp(data, control_data, len) != 0) {
+			status = status ? status : -EIO;
+			msleep(50);
+			continue;
+		}
+		break;
+	}
+
+	kfree(control_data);
+
+	return status;
+}
+
 int uniwill_write_ec_ram_with_retry(u16 address, u8 data, int retries)
 {
 	int status, i;
@@ -181,7 +829,8 @@ int uniwill_write_ec_ram_with_retry(u16 address, u8 data, int retries)
 			continue;
 		}
 		else {
-			status = uniwill_read_ec_ram(address, &control_data);
+			// Verify against the EC, not the shadow
+			status = __uniwill_read_ec_ram(address, &control_data);
 			if (status != 0 || data != control_data) {
 				msleep(50);
 				continue;
@@ -194,6 +843,102 @@ int uniwill_write_ec_ram_with_retry(u16 address, u8 data, int retries)
 }
 EXPORT_SYMBOL(uniwill_write_ec_ram_with_retry);
 
+/*
+ * Write transactions on a contiguous EC RAM window
+ *
+ * Writes are queued with uw_ec_transaction_write() and applied on commit:
+ * Writes whose target is known to hold the value from the shadow are elided,
+ * the remaining ones are written in contiguous runs and verified with a
+ * single read-back. Only bytes that failed verification are retried. The EC
+ * is only read for verification, so elision needs the window in the shadow
+ * as write-through, otherwise every queued byte is written.
+ */
+#define UW_EC_TRANSACTION_MAX_LEN 0x80
+
+struct uw_ec_transaction_t {
+	u16 address;
+	u16 len;
+	u8 data[UW_EC_TRANSACTION_MAX_LEN];
+	DECLARE_BITMAP(queued, UW_EC_TRANSACTION_MAX_LEN);
+};
+
+static void uw_ec_transaction_begin(struct uw_ec_transaction_t *t, u16 address, u16 len)
+{
+	t->address = address;
+	t->len = min_t(u16, len, UW_EC_TRANSACTION_MAX_LEN);
+	bitmap_zero(t->queued, UW_EC_TRANSACTION_MAX_LEN);
+}
+
+static int uw_ec_transaction_write(struct uw_ec_transaction_t *t, u16 address, u8 data)
+{
+	u16 offset = address - t->address;
+
+	if (address < t->address || offset >= t->len)
+		return -EINVAL;
+
+	t->data[offset] = data;
+	set_bit(offset, t->queued);
+
+	return 0;
+}
+
+static int uw_ec_transaction_commit(struct uw_ec_transaction_t *t, int retries)
+{
+	u8 current_data[UW_EC_TRANSACTION_MAX_LEN];
+	DECLARE_BITMAP(pending, UW_EC_TRANSACTION_MAX_LEN);
+	unsigned int first, last, run_end, queued, elided;
+	int status, i;
+
+	queued = bitmap_weight(t->queued, t->len);
+	if (queued == 0)
+		return 0;
+
+	bitmap_copy(pending, t->queued, UW_EC_TRANSACTION_MAX_LEN);
+
+	// Elide writes whose target is known to already hold the value
+	mutex_lock(&uw_ec_shadow_lock);
+	for_each_set_bit(first, t->queued, t->len)
+		if (uw_ec_shadow_lookup(t->address + first, &current_data[first]) &&
+		    current_data[first] == t->data[first])
+			clear_bit(first, pending);
+	mutex_unlock(&uw_ec_shadow_lock);
+	elided = queued - bitmap_weight(pending, t->len);
+
+	for (i = 0; i < retries && !bitmap_empty(pending, t->len); ++i) {
+		if (i > 0)
+			msleep(50);
+
+		// Write pending bytes in contiguous runs
+		first = find_first_bit(pending, t->len);
+		while (first < t->len) {
+			run_end = find_next_zero_bit(pending, t->len, first);
+			uniwill_write_ec_ram_bulk(t->address + first, &t->data[first], run_end - first);
+			first = find_next_bit(pending, t->len, run_end);
+		}
+
+		// Verify the written span with one read-back
+		first = find_first_bit(pending, t->len);
+		last = find_last_bit(pending, t->len);
+		status = __uniwill_read_ec_ram_bulk(t->address + first, &current_data[first], last - first + 1);
+		if (status)
+			continue;
+		mutex_lock(&uw_ec_shadow_lock);
+		for (; first <= last; ++first) {
+			if (!test_bit(first, pending))
+				continue;
+			if (current_data[first] == t->data[first])
+				clear_bit(first, pending);
+			else
+				uw_ec_shadow_drop(t->address + first);
+		}
+		mutex_unlock(&uw_ec_shadow_lock);
+	}
+
+	pr_debug("ec transaction 0x%04x: %u queued, %u elided, %u failed\n",
+		 t->address, queued, elided, bitmap_weight(pending, t->len));
+
+	return bitmap_empty(pending, t->len) ? 0 : -EIO;
+}
 
 int uniwill_wmi_evaluate(u8 function, u32 arg, u32 *return_buffer)
 {
@@ -217,9 +962,16 @@ int uniwill_add_interface(struct uniwill_interface_t *interface)
 {
 	mutex_lock(&uniwill_interface_modification_lock);
 
-	if (strcmp(interface->string_id, UNIWILL_INTERFACE_WMI_STRID) == 0)
+	if (strcmp(interface->string_id, UNIWILL_INTERFACE_WMI_STRID) == 0 ||
+	    strcmp(interface->string_id, UNIWILL_INTERFACE_SIM_STRID) == 0) {
+		// The simulated interface takes the place of the WMI one, only one can be active
+		if (!IS_ERR_OR_NULL(uniwill_interfaces.wmi) && uniwill_interfaces.wmi != interface) {
+			TUXEDO_DEBUG("interface %s already active\n", uniwill_interfaces.wmi->string_id);
+			mutex_unlock(&uniwill_interface_modification_lock);
+			return -EBUSY;
+		}
 		uniwill_interfaces.wmi = interface;
-	else {
+	} else {
 		TUXEDO_DEBUG("trying to add unknown interface\n");
 		mutex_unlock(&uniwill_interface_modification_lock);
 		return -EINVAL;
@@ -239,7 +991,7 @@ int uniwill_remove_interface(struct uniwill_interface_t *interface)
 {
 	mutex_lock(&uniwill_interface_modification_lock);
 
-	if (strcmp(interface->string_id, UNIWILL_INTERFACE_WMI_STRID) == 0) {
+	if (uniwill_interfaces.wmi == interface) {
 		// Remove driver if last interface is removed
 		tuxedo_keyboard_remove_driver(&uniwill_keyboard_driver);
 
@@ -293,8 +1045,19 @@ static void uniwill_write_kbd_bl_enable(u8 enable)
 	uniwill_write_ec_ram(UW_EC_REG_KBD_BL_STATUS, backlight_data);
 }
 
+static void uw_dc_adapter_change_replay(void)
+{
+	uniwill_set_custom_profile_mode(false);
+	uniwill_leds_restore_state_extern();
+	msleep(50);
+	uw_charging_priority_write_state();
+	uw_charging_profile_write_state();
+}
+
 void uniwill_event_callb(u32 code)
 {
+	atomic_notifier_call_chain(&uniwill_event_notifier, code, NULL);
+
 	switch (code) {
 		case UNIWILL_OSD_MODE_CHANGE_KEY_EVENT:
 			// Special key combination when mode change key is pressed (the one next to
@@ -311,11 +1074,8 @@ void uniwill_event_callb(u32 code)
 		case UNIWILL_OSD_DC_ADAPTER_CHANGE:
 			// Refresh keyboard state and charging settings on cable switch event and make sure that the custom
 			// profile mode is still applied in case it's needed.
-			uniwill_set_custom_profile_mode(false);
-			uniwill_leds_restore_state_extern();
-			msleep(50);
-			uw_charging_priority_write_state();
-			uw_charging_profile_write_state();
+			uniwill_ec_shadow_invalidate();
+			uniwill_ec_queue_call(uw_dc_adapter_change_replay);
 			break;
 		case UNIWILL_KEY_KBDILLUMTOGGLE:
 		case UNIWILL_OSD_KB_LED_LEVEL0:
@@ -360,24 +1120,28 @@ static void uniwill_set_custom_profile_mode(bool zero_bit_initially)
 #define UNIWILL_LIGHTBAR_LED_NAME_RGB_BLUE	"lightbar_rgb:3:status"
 #define UNIWILL_LIGHTBAR_LED_NAME_ANIMATION	"lightbar_animation::status"
 
+// Async, quick brightness changes collapse into the last value per channel
 static void uniwill_write_lightbar_rgb(u8 red, u8 green, u8 blue)
 {
 	if (red <= UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS) {
-		uniwill_write_ec_ram(0x0749, red);
+		uniwill_write_ec_ram_async(0x0749, red);
 	}
 	if (green <= UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS) {
-		uniwill_write_ec_ram(0x074a, green);
+		uniwill_write_ec_ram_async(0x074a, green);
 	}
 	if (blue <= UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS) {
-		uniwill_write_ec_ram(0x074b, blue);
+		uniwill_write_ec_ram_async(0x074b, blue);
 	}
 }
 
 static void uniwill_read_lightbar_rgb(u8 *red, u8 *green, u8 *blue)
 {
-	uniwill_read_ec_ram(0x0749, red);
-	uniwill_read_ec_ram(0x074a, green);
-	uniwill_read_ec_ram(0x074b, blue);
+	u8 rgb[3] = { 0 };
+
+	uniwill_read_ec_ram_bulk(0x0749, rgb, sizeof(rgb));
+	*red = rgb[0];
+	*green = rgb[1];
+	*blue = rgb[2];
 }
 
 static void uniwill_write_lightbar_animation(bool animation_status)
@@ -1212,7 +1976,7 @@ static ssize_t raw_cycle_count_show(struct device *device,
 {
 	int result;
 	u16 cycle_count;
-	result = uniwill_read_ec_ram_u16(UW_EC_REG_BATTERY_CYCN_HI, UW_EC_REG_BATTERY_CYCN_LO, &cycle_count);
+	result = uniwill_read_ec_ram_u16(UW_EC_REG_BATTERY_CYCN_LO, &cycle_count);
 	if (result)
 		return result;
 	return snprintf(buf, PAGE_SIZE, "%d\n", cycle_count);
@@ -1224,7 +1988,7 @@ static ssize_t raw_xif1_show(struct device *device,
 {
 	int result;
 	u16 xif1;
-	result = uniwill_read_ec_ram_u16(UW_EC_REG_BATTERY_XIF1_HI, UW_EC_REG_BATTERY_XIF1_LO, &xif1);
+	result = uniwill_read_ec_ram_u16(UW_EC_REG_BATTERY_XIF1_LO, &xif1);
 	if (result)
 		return result;
 	return snprintf(buf, PAGE_SIZE, "%d\n", xif1);
@@ -1236,7 +2000,7 @@ static ssize_t raw_xif2_show(struct device *device,
 {
 	int result;
 	u16 xif2;
-	result = uniwill_read_ec_ram_u16(UW_EC_REG_BATTERY_XIF2_HI, UW_EC_REG_BATTERY_XIF2_LO, &xif2);
+	result = uniwill_read_ec_ram_u16(UW_EC_REG_BATTERY_XIF2_LO, &xif2);
 	if (result)
 		return result;
 	return snprintf(buf, PAGE_SIZE, "%d\n", xif2);
@@ -1558,83 +2322,290 @@ static const struct dmi_system_id uw_sku_romid_table[] = {
 	// IBPG8 mk1
 	// Logic: If product serial matches 16inch use that, else default to 14inch
 	{
-		.matches = {
-			DMI_MATCH(DMI_PRODUCT_SKU, "IBP1XI08MK1"),
-			DMI_MATCH(DMI_PRODUCT_SERIAL, "PH6PRX"),
-		},
-		.driver_data = (void *)&uw_romid_PH6PxX
+		.matches = {
+			DMI_MATCH(DMI_PRODUCT_SKU, "IBP1XI08MK1"),
+			DMI_MATCH(DMI_PRODUCT_SERIAL, "PH6PRX"),
+		},
+		.driver_data = (void *)&uw_romid_PH6PxX
+	},
+	{
+		.matches = {
+			DMI_MATCH(DMI_PRODUCT_SKU, "IBP1XI08MK1"),
+		},
+		.driver_data = (void *)&uw_romid_PH4PxX
+	},
+	// IBP16G8 mk2
+	{
+		.matches = {
+			DMI_MATCH(DMI_PRODUCT_SKU, "IBP1XI08MK2"),
+			DMI_MATCH(DMI_PRODUCT_SERIAL, "PH6"),
+		},
+		.driver_data = (void *)&uw_romid_PH6PxX
+	},
+	{}
+};
+
+static int set_rom_id(void) {
+	int i, ret;
+	const struct dmi_system_id *uw_sku_romid;
+	const u8 *romid;
+	u8 data[14];
+	static const u8 romid_special[2] = { 0xA5, 0x78 };
+	bool romid_false = false;
+
+	uw_sku_romid = dmi_first_match(uw_sku_romid_table);
+	if (!uw_sku_romid)
+		return 0;
+
+	romid = (const u8 *)uw_sku_romid->driver_data;
+	pr_debug("ROMID 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X\n",
+		 romid[0], romid[1], romid[2], romid[3], romid[4], romid[5], romid[6], romid[7],
+		 romid[8], romid[9], romid[10], romid[11], romid[12], romid[13]);
+
+	for (i = 0; i < 3; ++i) {
+		ret = uniwill_read_ec_ram_bulk(UW_EC_REG_ROMID_START, data, sizeof(data));
+		if (!ret)
+			break;
+	}
+	if (ret) {
+		pr_debug("uniwill_read_ec_ram_bulk(...) failed.\n");
+		return ret;
+	}
+
+	for (i = 0; i < 14; ++i) {
+		pr_debug("ROMID index: %d, expected value: 0x%02X, actual value: 0x%02X\n", i, romid[i], data[i]);
+		if (data[i] != romid[i]) {
+			pr_debug("ROMID is false. Correcting...\n");
+			romid_false = true;
+			break;
+		}
+	}
+
+	if (romid_false) {
+		ret = uniwill_write_ec_ram_bulk_with_retry(UW_EC_REG_ROMID_SPECIAL_1, romid_special, sizeof(romid_special), 3);
+		if (ret) {
+			pr_debug("uniwill_write_ec_ram_bulk_with_retry(...) failed.\n");
+			return ret;
+		}
+		ret = uniwill_write_ec_ram_bulk_with_retry(UW_EC_REG_ROMID_START, romid, 14, 3);
+		if (ret) {
+			pr_debug("uniwill_write_ec_ram_bulk_with_retry(...) failed.\n");
+			return ret;
+		}
+	}
+	else
+		pr_debug("ROMID is correct.\n");
+
+	return 0;
+}
+
+/*
+ * DMI quirks, all matching entries are OR'ed together. Evaluated once, the
+ * result does not change at runtime.
+ */
+#define UW_QUIRK_PROFILE_V1_TWO_PROFS			BIT(0)
+#define UW_QUIRK_PROFILE_V1_THREE_PROFS			BIT(1)
+#define UW_QUIRK_PROFILE_V1_THREE_PROFS_LEDS_ONLY	BIT(2)
+#define UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED		BIT(3)
+/*
+ * For some devices the "universal fan control" doesn't work for turning the
+ * fans off reliably, however, the old fan control works.
+ */
+#define UW_QUIRK_NO_UNIVERSAL_EC_FAN_CONTROL		BIT(4)
+
+static const struct dmi_system_id uw_quirk_table[] = {
+	// Profile v1, two profiles
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "PF5PU1G") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_TWO_PROFS)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "PULSE1401") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_TWO_PROFS)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "PULSE1501") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_TWO_PROFS)
+	},
+	// Profile v1, three profiles ("classic" profile support)
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "POLARIS1501A1650TI") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "POLARIS1501A2060") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "POLARIS1501I1650TI") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "POLARIS1501I2060") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "POLARIS1701A1650TI") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "POLARIS1701A2060") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "POLARIS1701I1650TI") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "POLARIS1701I2060") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "GXxMRXx") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS | UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED |
+					UW_QUIRK_NO_UNIVERSAL_EC_FAN_CONTROL)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "GXxHRXx") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS | UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "XxHP4NAx") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS | UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "XxKK4NAx_XxSP4NAx") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS | UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "XxAR4NAx") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS | UW_QUIRK_NO_UNIVERSAL_EC_FAN_CONTROL)
+	},
+	// Note: XMG Fusion removed for now, seem to have
+	// neither same power profile control nor TDP set
+	// LAPQC71A, LAPQC71B, product name A60 MUV
+	// Custom profile mode needed for custom TDP values (and sometimes fan control)
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "X5KK45xS_X5SP45xS") },
+		.driver_data = (void *)(UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "X6KK45xU_X6SP45xU") },
+		.driver_data = (void *)(UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "X6AR55xU") },
+		.driver_data = (void *)(UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "X5AR45xS") },
+		.driver_data = (void *)(UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED | UW_QUIRK_NO_UNIVERSAL_EC_FAN_CONTROL)
+	},
+	// Universal fan control doesn't turn the fans off reliably, old fan control works
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_BOARD_NAME, "X6FR5xxY") },
+		.driver_data = (void *)(UW_QUIRK_NO_UNIVERSAL_EC_FAN_CONTROL)
+	},
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
+	// Profile mainly controls power profile LED status
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "POLARIS1XA02") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS_LEDS_ONLY)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "POLARIS1XI02") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS_LEDS_ONLY)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "POLARIS1XA03") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS_LEDS_ONLY)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "POLARIS1XI03") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS_LEDS_ONLY)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "STELLARIS1XI03") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS_LEDS_ONLY)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "STELLARIS1XA03") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS_LEDS_ONLY)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "STELLARIS1XI04") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS_LEDS_ONLY)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "STEPOL1XA04") },
+		.driver_data = (void *)(UW_QUIRK_PROFILE_V1_THREE_PROFS_LEDS_ONLY)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "STELLARIS16I06") },
+		.driver_data = (void *)(UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "STELLARIS17I06") },
+		.driver_data = (void *)(UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
 	},
 	{
-		.matches = {
-			DMI_MATCH(DMI_PRODUCT_SKU, "IBP1XI08MK1"),
-		},
-		.driver_data = (void *)&uw_romid_PH4PxX
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "STELLARIS16I07") },
+		.driver_data = (void *)(UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
 	},
-	// IBP16G8 mk2
 	{
-		.matches = {
-			DMI_MATCH(DMI_PRODUCT_SKU, "IBP1XI08MK2"),
-			DMI_MATCH(DMI_PRODUCT_SERIAL, "PH6"),
-		},
-		.driver_data = (void *)&uw_romid_PH6PxX
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "STELLARIS16A07") },
+		.driver_data = (void *)(UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
 	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "STELLSL15I06") },
+		.driver_data = (void *)(UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
+	},
+	{
+		.matches = { DMI_EXACT_MATCH(DMI_PRODUCT_SKU, "STELLSL15A06") },
+		.driver_data = (void *)(UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED)
+	},
+#endif
 	{}
 };
 
-static int set_rom_id(void) {
-	int i, ret;
-	const struct dmi_system_id *uw_sku_romid;
-	const u8 *romid;
-	u8 data;
-	bool romid_false = false;
+static unsigned long uw_quirks;
+static bool uw_quirks_loaded = false;
 
-	uw_sku_romid = dmi_first_match(uw_sku_romid_table);
-	if (!uw_sku_romid)
-		return 0;
+static int uw_quirk_dmi_callback(const struct dmi_system_id *id)
+{
+	uw_quirks |= (unsigned long)id->driver_data;
+	// Continue, later entries can add more quirks
+	return 0;
+}
 
-	romid = (const u8 *)uw_sku_romid->driver_data;
-	pr_debug("ROMID 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X\n",
-		 romid[0], romid[1], romid[2], romid[3], romid[4], romid[5], romid[6], romid[7],
-		 romid[8], romid[9], romid[10], romid[11], romid[12], romid[13]);
+static void uw_quirks_load(void)
+{
+	if (uw_quirks_loaded)
+		return;
 
-	for (i = 0; i < 14; ++i) {
-		ret = uniwill_read_ec_ram_with_retry(UW_EC_REG_ROMID_START + i, &data, 3);
-		if (ret) {
-			pr_debug("uniwill_read_ec_ram_with_retry(...) failed.\n");
-			return ret;
-		}
-		pr_debug("ROMID index: %d, expected value: 0x%02X, actual value: 0x%02X\n", i, romid[i], data);
-		if (data != romid[i]) {
-			pr_debug("ROMID is false. Correcting...\n");
-			romid_false = true;
-			break;
-		}
-	}
+	dmi_check_system(uw_quirk_table);
+	uw_quirks_loaded = true;
+	pr_debug("dmi quirks: 0x%lx\n", uw_quirks);
+}
 
-	if (romid_false) {
-		ret = uniwill_write_ec_ram_with_retry(UW_EC_REG_ROMID_SPECIAL_1, 0xA5, 3);
-		if (ret) {
-			pr_debug("uniwill_write_ec_ram_with_retry(...) failed.\n");
-			return ret;
-		}
-		ret = uniwill_write_ec_ram_with_retry(UW_EC_REG_ROMID_SPECIAL_2, 0x78, 3);
-		if (ret) {
-			pr_debug("uniwill_write_ec_ram_with_retry(...) failed.\n");
-			return ret;
-		}
-		for (i = 0; i < 14; ++i) {
-			ret = uniwill_write_ec_ram_with_retry(UW_EC_REG_ROMID_START + i, romid[i], 3);
-			if (ret) {
-				pr_debug("uniwill_write_ec_ram_with_retry(...) failed.\n");
-				return ret;
-			}
-		}
-	}
-	else
-		pr_debug("ROMID is correct.\n");
+/*
+ * Feature bits read from the EC. Each one is tracked separately so that only
+ * the probes that failed are retried on the next call.
+ */
+enum uw_ec_feature {
+	UW_EC_FEATURE_MODEL,
+	UW_EC_FEATURE_DOUBLE_PL4,
+	UW_EC_FEATURE_CHARGING_PRIO,
+	UW_EC_FEATURE_CHARGING_PROFILE,
+	UW_EC_FEATURE_AC_AUTO_BOOT,
+	UW_EC_FEATURE_USB_POWERSHARE,
+	UW_EC_FEATURE_MINI_LED_LOCAL_DIMMING,
+	UW_EC_FEATURE_HIDDEN_BIOS_OPTIONS,
+	UW_EC_FEATURE_UNIVERSAL_EC_FAN_CONTROL,
+	UW_EC_FEATURE_COUNT
+};
 
-	return 0;
-}
+static DECLARE_BITMAP(uw_ec_features_known, UW_EC_FEATURE_COUNT);
 
 static int has_universal_ec_fan_control(void) {
 	int ret;
@@ -1647,12 +2618,7 @@ static int has_universal_ec_fan_control(void) {
 		// "GPU" fan curve when the bit to separate both fancurves is set, but the old fan
 		// control works just fine.
 		|| uw_feats->model == UW_MODEL_PH4TRX
-		// For some devices the "universal fan control" doesn't work for turning the fans
-		// off reliably, however, the old fan control works.
-		|| dmi_match(DMI_BOARD_NAME, "GXxMRXx")
-		|| dmi_match(DMI_BOARD_NAME, "XxAR4NAx")
-		|| dmi_match(DMI_BOARD_NAME, "X6FR5xxY")
-		|| dmi_match(DMI_BOARD_NAME, "X5AR45xS")
+		|| (uw_quirks & UW_QUIRK_NO_UNIVERSAL_EC_FAN_CONTROL)
 	;
 
 	if (universal_fan_control_exception) {
@@ -1683,122 +2649,81 @@ static int has_double_pl4(bool *status)
 	return 0;
 }
 
-struct uniwill_device_features_t *uniwill_get_device_features(void)
+static int uw_ec_feature_probe(enum uw_ec_feature feature)
 {
 	struct uniwill_device_features_t *uw_feats = &uniwill_device_features;
-	u32 status;
 	int result;
-	bool feats_loaded;
-
-	if (uw_feats_loaded)
-		return uw_feats;
 
-	feats_loaded = true;
-
-	status = uniwill_read_ec_ram(0x0740, &uw_feats->model);
-	if (status != 0) {
-		uw_feats->model = 0;
-		feats_loaded = false;
+	switch (feature) {
+	case UW_EC_FEATURE_MODEL:
+		result = uniwill_read_ec_ram(UW_EC_REG_BAREBONE_ID, &uw_feats->model);
+		if (result)
+			uw_feats->model = 0;
+		return result;
+	case UW_EC_FEATURE_DOUBLE_PL4:
+		return has_double_pl4(&uw_feats->uniwill_has_double_pl4);
+	case UW_EC_FEATURE_CHARGING_PRIO:
+		return uw_has_charging_priority(&uw_feats->uniwill_has_charging_prio);
+	case UW_EC_FEATURE_CHARGING_PROFILE:
+		return uw_has_charging_profile(&uw_feats->uniwill_has_charging_profile);
+	case UW_EC_FEATURE_AC_AUTO_BOOT:
+		return uw_has_ac_auto_boot(&uw_feats->uniwill_has_ac_auto_boot);
+	case UW_EC_FEATURE_USB_POWERSHARE:
+		return uw_has_usb_powershare(&uw_feats->uniwill_has_usb_powershare);
+	case UW_EC_FEATURE_MINI_LED_LOCAL_DIMMING:
+		return uw_has_mini_led_local_dimming(&uw_feats->uniwill_has_mini_led_local_dimming);
+	case UW_EC_FEATURE_HIDDEN_BIOS_OPTIONS:
+		return uw_has_hidden_bios_options(&uw_feats->uniwill_has_hidden_bios_options);
+	case UW_EC_FEATURE_UNIVERSAL_EC_FAN_CONTROL:
+		// Exception list depends on the model
+		if (!test_bit(UW_EC_FEATURE_MODEL, uw_ec_features_known))
+			return -EAGAIN;
+		result = has_universal_ec_fan_control();
+		if (result < 0)
+			return result;
+		uw_feats->uniwill_has_universal_ec_fan_control = (result == 1);
+		return 0;
+	default:
+		return -EINVAL;
 	}
+}
 
-	uw_feats->uniwill_profile_v1_two_profs = false
-		|| dmi_match(DMI_BOARD_NAME, "PF5PU1G")
-		|| dmi_match(DMI_BOARD_NAME, "PULSE1401")
-		|| dmi_match(DMI_BOARD_NAME, "PULSE1501")
-	;
-
-	uw_feats->uniwill_profile_v1_three_profs = false
-	// Devices with "classic" profile support
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1501A1650TI")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1501A2060")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1501I1650TI")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1501I2060")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1701A1650TI")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1701A2060")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1701I1650TI")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1701I2060")
-		|| dmi_match(DMI_BOARD_NAME, "GXxMRXx")
-		|| dmi_match(DMI_BOARD_NAME, "GXxHRXx")
-		|| dmi_match(DMI_BOARD_NAME, "XxHP4NAx")
-		|| dmi_match(DMI_BOARD_NAME, "XxKK4NAx_XxSP4NAx")
-		|| dmi_match(DMI_BOARD_NAME, "XxAR4NAx")
-
-		// Note: XMG Fusion removed for now, seem to have
-		// neither same power profile control nor TDP set
-		//|| dmi_match(DMI_BOARD_NAME, "LAPQC71A")
-		//|| dmi_match(DMI_BOARD_NAME, "LAPQC71B")
-		//|| dmi_match(DMI_PRODUCT_NAME, "A60 MUV")
-	;
+struct uniwill_device_features_t *uniwill_get_device_features(void)
+{
+	struct uniwill_device_features_t *uw_feats = &uniwill_device_features;
+	int feature;
 
-	uw_feats->uniwill_profile_v1_three_profs_leds_only = false
-	// Devices where profile mainly controls power profile LED status
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
-		|| dmi_match(DMI_PRODUCT_SKU, "POLARIS1XA02")
-		|| dmi_match(DMI_PRODUCT_SKU, "POLARIS1XI02")
-		|| dmi_match(DMI_PRODUCT_SKU, "POLARIS1XA03")
-		|| dmi_match(DMI_PRODUCT_SKU, "POLARIS1XI03")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XI03")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XA03")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XI04")
-		|| dmi_match(DMI_PRODUCT_SKU, "STEPOL1XA04")
-#endif
-	;
+	if (uw_feats_loaded)
+		return uw_feats;
 
-	uw_feats->uniwill_custom_profile_mode_needed = false
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS16I06")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS17I06")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS16I07")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS16A07")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLSL15I06")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLSL15A06")
-		|| dmi_match(DMI_BOARD_NAME, "GXxMRXx")
-		|| dmi_match(DMI_BOARD_NAME, "GXxHRXx")
-		|| dmi_match(DMI_BOARD_NAME, "XxHP4NAx")
-		|| dmi_match(DMI_BOARD_NAME, "XxKK4NAx_XxSP4NAx")
-		|| dmi_match(DMI_BOARD_NAME, "X5KK45xS_X5SP45xS")
-		|| dmi_match(DMI_BOARD_NAME, "X6KK45xU_X6SP45xU")
-		|| dmi_match(DMI_BOARD_NAME, "X6AR55xU")
-		|| dmi_match(DMI_BOARD_NAME, "X5AR45xS")
-#endif
-	;
+	if (!uw_quirks_loaded) {
+		uw_quirks_load();
 
+		uw_feats->uniwill_profile_v1_two_profs = uw_quirks & UW_QUIRK_PROFILE_V1_TWO_PROFS;
+		uw_feats->uniwill_profile_v1_three_profs = uw_quirks & UW_QUIRK_PROFILE_V1_THREE_PROFS;
+		uw_feats->uniwill_profile_v1_three_profs_leds_only = uw_quirks & UW_QUIRK_PROFILE_V1_THREE_PROFS_LEDS_ONLY;
+		uw_feats->uniwill_custom_profile_mode_needed = uw_quirks & UW_QUIRK_CUSTOM_PROFILE_MODE_NEEDED;
+		uw_feats->uniwill_profile_v1 =
+			uw_feats->uniwill_profile_v1_two_profs ||
+			uw_feats->uniwill_profile_v1_three_profs;
+	}
 
-	if (has_double_pl4(&uw_feats->uniwill_has_double_pl4) != 0)
-		feats_loaded = false;
-
-	uw_feats->uniwill_profile_v1 =
-		uw_feats->uniwill_profile_v1_two_profs ||
-		uw_feats->uniwill_profile_v1_three_profs;
-
-	if (uw_has_charging_priority(&uw_feats->uniwill_has_charging_prio) != 0)
-		feats_loaded = false;
-	if (uw_has_charging_profile(&uw_feats->uniwill_has_charging_profile) != 0)
-		feats_loaded = false;
-	if (uw_has_ac_auto_boot(&uw_feats->uniwill_has_ac_auto_boot) != 0)
-		feats_loaded = false;
-	if (uw_has_usb_powershare(&uw_feats->uniwill_has_usb_powershare) != 0)
-		feats_loaded = false;
-	if (uw_has_mini_led_local_dimming(&uw_feats->uniwill_has_mini_led_local_dimming) != 0)
-		feats_loaded = false;
-	if (uw_has_hidden_bios_options(&uw_feats->uniwill_has_hidden_bios_options) != 0)
-		feats_loaded = false;
-
-	result = has_universal_ec_fan_control();
-	if (result < 0) {
-		feats_loaded = false;
-	} else {
-		uw_feats->uniwill_has_universal_ec_fan_control = (result == 1);
+	for (feature = 0; feature < UW_EC_FEATURE_COUNT; ++feature) {
+		if (test_bit(feature, uw_ec_features_known))
+			continue;
+		if (uw_ec_feature_probe(feature) == 0)
+			set_bit(feature, uw_ec_features_known);
+		else
+			pr_debug("feature %d not yet known\n", feature);
 	}
 
+	uw_feats_loaded = bitmap_full(uw_ec_features_known, UW_EC_FEATURE_COUNT);
 
-	if (feats_loaded)
+	if (uw_feats_loaded)
 		pr_debug("feats loaded\n");
 	else
 		pr_debug("feats not yet loaded\n");
 
-	uw_feats_loaded = feats_loaded;
-
 	return uw_feats;
 }
 EXPORT_SYMBOL(uniwill_get_device_features);
@@ -1896,11 +2821,22 @@ static u8 direct_fan_control_current_value_fan1 = 0;
 static u8 direct_fan_control_current_value_fan0_suspend_save = 0;
 static u8 direct_fan_control_current_value_fan1_suspend_save = 0;
 static bool fans_initialized = false;
+static struct uniwill_fan_curve_t uw_fan_curves[2];
+static bool uw_fan_curve_set[2];
+// Serializes fan table uploads and the uw_fan_curves/uw_fan_curve_set state
+static DEFINE_MUTEX(uw_fan_curve_lock);
+static int uw_write_fan_curve(u32 fan_index, const struct uniwill_fan_curve_t *curve);
 static bool direct_fan_control_started = false;
 static bool direct_fan_control_suspend = false;
+static bool direct_fan_control_asserted = false;
+static u64 direct_fan_control_reassertions = 0;
+static u64 direct_fan_control_value_corrections = 0;
 static void restart_direct_fan_control_work_handler(struct work_struct *work);
 static DECLARE_DELAYED_WORK(direct_fan_control_restart_delayed_work, restart_direct_fan_control_work_handler);
 
+// Interval for checking whether the EC dropped the requested direct fan control state
+#define DIRECT_FAN_CONTROL_MONITOR_INTERVAL_MS	(30 * 1000)
+
 int set_full_fan_mode(bool enable) {
 	u8 mode_data;
 
@@ -1921,6 +2857,7 @@ EXPORT_SYMBOL(set_full_fan_mode);
 
 int uw_init_fan(void) {
 	struct uniwill_device_features_t *uw_feats = &uniwill_device_features;
+	struct uw_ec_transaction_t fan_tables;
 	int i, temp_offset;
 
 	u16 addr_use_custom_fan_table_0 = 0x07c5; // use different tables for both fans (0x0f00-0x0f2f and 0x0f30-0x0f5f respectivly)
@@ -1948,21 +2885,24 @@ int uw_init_fan(void) {
 		// - one controllable zone 0-115 deg
 		// - rest 116-117, 117-118 etc single non reachable dummy zones
 		//   with increasing ranges and max fan (same or increasing)
-		uniwill_write_ec_ram_with_retry(addr_cpu_custom_fan_table_end_temp, 115, 3);
-		uniwill_write_ec_ram_with_retry(addr_cpu_custom_fan_table_start_temp, 0, 3);
-		uniwill_write_ec_ram_with_retry(addr_cpu_custom_fan_table_fan_speed, 0x01, 3);
-		uniwill_write_ec_ram_with_retry(addr_gpu_custom_fan_table_end_temp, 120, 3);
-		uniwill_write_ec_ram_with_retry(addr_gpu_custom_fan_table_start_temp, 0, 3);
-		uniwill_write_ec_ram_with_retry(addr_gpu_custom_fan_table_fan_speed, 0x01, 3);
+		uw_ec_transaction_begin(&fan_tables, addr_cpu_custom_fan_table_end_temp, 0x60);
+		uw_ec_transaction_write(&fan_tables, addr_cpu_custom_fan_table_end_temp, 115);
+		uw_ec_transaction_write(&fan_tables, addr_cpu_custom_fan_table_start_temp, 0);
+		uw_ec_transaction_write(&fan_tables, addr_cpu_custom_fan_table_fan_speed, 0x01);
+		uw_ec_transaction_write(&fan_tables, addr_gpu_custom_fan_table_end_temp, 120);
+		uw_ec_transaction_write(&fan_tables, addr_gpu_custom_fan_table_start_temp, 0);
+		uw_ec_transaction_write(&fan_tables, addr_gpu_custom_fan_table_fan_speed, 0x01);
 		temp_offset = 115;
 		for (i = 0x1; i <= 0xf; ++i) {
-			uniwill_write_ec_ram_with_retry(addr_cpu_custom_fan_table_end_temp + i, temp_offset + i + 1, 3);
-			uniwill_write_ec_ram_with_retry(addr_cpu_custom_fan_table_start_temp + i, temp_offset + i, 3);
-			uniwill_write_ec_ram_with_retry(addr_cpu_custom_fan_table_fan_speed + i, 0xc8, 3);
-			uniwill_write_ec_ram_with_retry(addr_gpu_custom_fan_table_end_temp + i, temp_offset + i + 1, 3);
-			uniwill_write_ec_ram_with_retry(addr_gpu_custom_fan_table_start_temp + i, temp_offset + i, 3);
-			uniwill_write_ec_ram_with_retry(addr_gpu_custom_fan_table_fan_speed + i, 0xc8, 3);
+			uw_ec_transaction_write(&fan_tables, addr_cpu_custom_fan_table_end_temp + i, temp_offset + i + 1);
+			uw_ec_transaction_write(&fan_tables, addr_cpu_custom_fan_table_start_temp + i, temp_offset + i);
+			uw_ec_transaction_write(&fan_tables, addr_cpu_custom_fan_table_fan_speed + i, 0xc8);
+			uw_ec_transaction_write(&fan_tables, addr_gpu_custom_fan_table_end_temp + i, temp_offset + i + 1);
+			uw_ec_transaction_write(&fan_tables, addr_gpu_custom_fan_table_start_temp + i, temp_offset + i);
+			uw_ec_transaction_write(&fan_tables, addr_gpu_custom_fan_table_fan_speed + i, 0xc8);
 		}
+		if (uw_ec_transaction_commit(&fan_tables, 3))
+			pr_err("fan table init failed\n");
 
 		uniwill_read_ec_ram(addr_use_custom_fan_table_1, &value_use_custom_fan_table_1);
 		if (!((value_use_custom_fan_table_1 >> offset_use_custom_fan_table_1) & 1)) {
@@ -1981,6 +2921,33 @@ static void restart_direct_fan_control_work_handler(struct work_struct *work)
 	int i;
 	u16 addr_fan0 = 0x1804;
 	u16 addr_fan1 = 0x1809;
+	u8 mode_data, fan0_data, fan1_data;
+	bool mode_drifted, fan_drifted;
+
+	if (direct_fan_control_asserted) {
+		// Only intervene when the EC has actually left the requested state
+		if (uniwill_read_ec_ram(0x0751, &mode_data) ||
+		    uniwill_read_ec_ram(addr_fan0, &fan0_data) ||
+		    uniwill_read_ec_ram(addr_fan1, &fan1_data))
+			goto reschedule;
+
+		mode_drifted = !(mode_data & 0x40);
+		fan_drifted = fan0_data != direct_fan_control_current_value_fan0 ||
+			      fan1_data != direct_fan_control_current_value_fan1;
+
+		if (!mode_drifted) {
+			if (fan_drifted) {
+				direct_fan_control_value_corrections += 1;
+				pr_debug("fan values drifted, rewrite\n");
+				uniwill_write_ec_ram(addr_fan0, direct_fan_control_current_value_fan0 & 0xff);
+				uniwill_write_ec_ram(addr_fan1, direct_fan_control_current_value_fan1 & 0xff);
+			}
+			goto reschedule;
+		}
+
+		direct_fan_control_reassertions += 1;
+		pr_debug("full fan mode dropped, reassert fan control\n");
+	}
 
 	pr_debug("restart fan control\n");
 
@@ -1997,7 +2964,19 @@ static void restart_direct_fan_control_work_handler(struct work_struct *work)
 	}
 	pr_debug("prevent ramp-up done\n");
 
-	schedule_delayed_work(&direct_fan_control_restart_delayed_work, msecs_to_jiffies(50 * 60 * 1000));
+	direct_fan_control_asserted = true;
+
+reschedule:
+	schedule_delayed_work(&direct_fan_control_restart_delayed_work,
+			      msecs_to_jiffies(DIRECT_FAN_CONTROL_MONITOR_INTERVAL_MS));
+}
+
+static void direct_fan_control_debugfs_init(void)
+{
+	debugfs_create_u64("fan_control_reassertions", 0444, uw_debugfs_dir,
+			   &direct_fan_control_reassertions);
+	debugfs_create_u64("fan_control_value_corrections", 0444, uw_debugfs_dir,
+			   &direct_fan_control_value_corrections);
 }
 
 static int direct_fan_control(u32 fan_index, u8 fan_speed, bool prevent_rampup)
@@ -2035,6 +3014,7 @@ u32 uw_set_fan(u32 fan_index, u8 fan_speed)
 	u16 addr_gpu_custom_fan_table_fan_speed = 0x0f50;
 
 	u8 byte_data;
+	struct uniwill_fan_curve_t single_zone = { .num_points = 1 };
 
 	if (uw_feats->uniwill_has_universal_ec_fan_control) {
 		uniwill_read_ec_ram(0x0751, &byte_data);
@@ -2067,7 +3047,16 @@ u32 uw_set_fan(u32 fan_index, u8 fan_speed)
 				fan_speed = 1;
 			}
 
-			uniwill_write_ec_ram(addr_for_fan, fan_speed & 0xff);
+			mutex_lock(&uw_fan_curve_lock);
+			if (uw_fan_curve_set[fan_index]) {
+				// Manual speed replaces the curve, back to the single zone table
+				uw_fan_curve_set[fan_index] = false;
+				single_zone.speed[0] = fan_speed;
+				uw_write_fan_curve(fan_index, &single_zone);
+			} else {
+				uniwill_write_ec_ram(addr_for_fan, fan_speed & 0xff);
+			}
+			mutex_unlock(&uw_fan_curve_lock);
 
 			direct_fan_control(fan_index, fan_speed, false);
 		}
@@ -2105,6 +3094,7 @@ u32 uw_set_fan_auto(void)
 	else {
 		cancel_delayed_work_sync(&direct_fan_control_restart_delayed_work);
 		direct_fan_control_started = false;
+		direct_fan_control_asserted = false;
 		// Get current mode
 		uniwill_read_ec_ram(0x0751, &mode_data);
 		// Switch off "full fan mode" (i.e. unset 0x40 bit)
@@ -2113,11 +3103,250 @@ u32 uw_set_fan_auto(void)
 
 	direct_fan_control_current_value_fan0 = 0;
 	direct_fan_control_current_value_fan1 = 0;
+	mutex_lock(&uw_fan_curve_lock);
+	uw_fan_curve_set[0] = false;
+	uw_fan_curve_set[1] = false;
+	mutex_unlock(&uw_fan_curve_lock);
 
 	return 0;
 }
 EXPORT_SYMBOL(uw_set_fan_auto);
 
+static u8 uw_fan_curve_limit_speed(u8 fan_speed)
+{
+	// Same limits as in uw_set_fan
+	if (fan_speed < FAN_ON_MIN_SPEED_PERCENT * NB02_FAN_SPEED_MAX / 2 / 100)
+		fan_speed = 0;
+	else if (fan_speed < FAN_ON_MIN_SPEED_PERCENT * NB02_FAN_SPEED_MAX / 100)
+		fan_speed = FAN_ON_MIN_SPEED_PERCENT * NB02_FAN_SPEED_MAX / 100;
+
+	// See uw_set_fan: 1 stops the fan without the 3 minute spin-up
+	if (fan_speed == 0)
+		fan_speed = 1;
+
+	return fan_speed;
+}
+
+static int uw_write_fan_curve(u32 fan_index, const struct uniwill_fan_curve_t *curve)
+{
+	struct uw_ec_transaction_t table;
+	u16 addr_end_temp = fan_index == 0 ? 0x0f00 : 0x0f30;
+	u16 addr_start_temp = addr_end_temp + 0x10;
+	u16 addr_fan_speed = addr_end_temp + 0x20;
+	u8 start, end;
+	int i;
+
+	uw_ec_transaction_begin(&table, addr_end_temp, 0x30);
+	for (i = 0; i < UW_FAN_CURVE_MAX_POINTS; ++i) {
+		if (i < curve->num_points) {
+			start = curve->temp[i];
+			end = i + 1 < curve->num_points ? curve->temp[i + 1] : UW_FAN_CURVE_TEMP_MAX;
+			uw_ec_transaction_write(&table, addr_fan_speed + i, uw_fan_curve_limit_speed(curve->speed[i]));
+		} else {
+			// Non reachable dummy zones with max fan as in uw_init_fan
+			start = UW_FAN_CURVE_TEMP_MAX + (i - curve->num_points);
+			end = start + 1;
+			uw_ec_transaction_write(&table, addr_fan_speed + i, NB02_FAN_SPEED_MAX);
+		}
+		uw_ec_transaction_write(&table, addr_end_temp + i, end);
+		uw_ec_transaction_write(&table, addr_start_temp + i, start);
+	}
+
+	return uw_ec_transaction_commit(&table, 3);
+}
+
+/**
+ * Upload a full temperature to fan speed curve into the EC fan tables. The
+ * EC then applies the curve on its own without host interaction.
+ * Called with uw_fan_curve_lock held.
+ */
+static int __uw_set_fan_curve(u32 fan_index, const struct uniwill_fan_curve_t *curve)
+{
+	struct uniwill_device_features_t *uw_feats = &uniwill_device_features;
+	int i, result;
+	u8 mode_data = 0;
+
+	if (!uw_feats->uniwill_has_universal_ec_fan_control)
+		return -ENODEV;
+
+	if (fan_index > 1)
+		return -EINVAL;
+
+	if (curve->num_points == 0 || curve->num_points > UW_FAN_CURVE_MAX_POINTS)
+		return -EINVAL;
+
+	// The first zone has to cover everything below the second point
+	if (curve->temp[0] != 0)
+		return -EINVAL;
+
+	for (i = 0; i < curve->num_points; ++i) {
+		if (curve->temp[i] >= UW_FAN_CURVE_TEMP_MAX ||
+		    curve->speed[i] > NB02_FAN_SPEED_MAX)
+			return -EINVAL;
+		if (i > 0 && curve->temp[i] <= curve->temp[i - 1])
+			return -EINVAL;
+	}
+
+	// Tables are not evaluated in full fan mode
+	result = uniwill_read_ec_ram(0x0751, &mode_data);
+	if (result)
+		return result;
+	if (mode_data & 0x40)
+		return -EBUSY;
+
+	uw_init_fan();
+
+	result = uw_write_fan_curve(fan_index, curve);
+	if (result)
+		return result;
+
+	uw_fan_curves[fan_index] = *curve;
+	uw_fan_curve_set[fan_index] = true;
+
+	return 0;
+}
+
+int uw_set_fan_curve(u32 fan_index, const struct uniwill_fan_curve_t *curve)
+{
+	int result;
+
+	mutex_lock(&uw_fan_curve_lock);
+	result = __uw_set_fan_curve(fan_index, curve);
+	mutex_unlock(&uw_fan_curve_lock);
+
+	return result;
+}
+EXPORT_SYMBOL(uw_set_fan_curve);
+
+static void uw_fan_curve_write_state(void)
+{
+	struct uniwill_fan_curve_t curve;
+	u32 i;
+
+	mutex_lock(&uw_fan_curve_lock);
+
+	// The EC might have dropped the custom table enable bits
+	if (uw_fan_curve_set[0] || uw_fan_curve_set[1])
+		fans_initialized = false;
+
+	for (i = 0; i < ARRAY_SIZE(uw_fan_curves); ++i) {
+		if (uw_fan_curve_set[i]) {
+			// __uw_set_fan_curve stores the curve again, pass a copy
+			curve = uw_fan_curves[i];
+			__uw_set_fan_curve(i, &curve);
+		}
+	}
+
+	mutex_unlock(&uw_fan_curve_lock);
+}
+
+static ssize_t uw_fan_curve_show(u32 fan_index, char *buffer)
+{
+	u8 table[0x30];
+	u16 addr_end_temp = fan_index == 0 ? 0x0f00 : 0x0f30;
+	int i, result;
+	ssize_t len = 0;
+
+	result = uniwill_read_ec_ram_bulk(addr_end_temp, table, sizeof(table));
+	if (result)
+		return result;
+
+	for (i = 0; i < UW_FAN_CURVE_MAX_POINTS; ++i) {
+		// Start temp at 0x10, fan speed at 0x20 relative to end temp
+		if (i > 0 && table[0x10 + i] >= UW_FAN_CURVE_TEMP_MAX)
+			break;
+		len += sprintf(buffer + len, "%s%u:%u", i > 0 ? " " : "",
+			       table[0x10 + i], table[0x20 + i]);
+	}
+	len += sprintf(buffer + len, "\n");
+
+	return len;
+}
+
+/*
+ * Input format: space separated "temp:speed" pairs, for example
+ * "0:0 50:60 70:120 85:200", the first pair has to start at 0 °C
+ */
+static ssize_t uw_fan_curve_store(u32 fan_index, const char *buffer, size_t size)
+{
+	struct uniwill_fan_curve_t curve = { 0 };
+	char *buffer_copy, *cursor, *token;
+	unsigned int temp, speed;
+	int result = 0;
+
+	buffer_copy = kstrndup(buffer, size, GFP_KERNEL);
+	if (!buffer_copy)
+		return -ENOMEM;
+
+	cursor = strstrip(buffer_copy);
+	while ((token = strsep(&cursor, " \t")) != NULL) {
+		if (*token == '\0')
+			continue;
+		if (curve.num_points >= UW_FAN_CURVE_MAX_POINTS ||
+		    sscanf(token, "%u:%u", &temp, &speed) != 2 ||
+		    temp > 0xff || speed > 0xff) {
+			result = -EINVAL;
+			break;
+		}
+		curve.temp[curve.num_points] = temp;
+		curve.speed[curve.num_points] = speed;
+		curve.num_points += 1;
+	}
+
+	kfree(buffer_copy);
+
+	if (result == 0)
+		result = uw_set_fan_curve(fan_index, &curve);
+
+	return result == 0 ? size : result;
+}
+
+static ssize_t fan1_show(struct device *child, struct device_attribute *attr, char *buffer)
+{
+	return uw_fan_curve_show(0, buffer);
+}
+
+static ssize_t fan1_store(struct device *child, struct device_attribute *attr,
+			  const char *buffer, size_t size)
+{
+	return uw_fan_curve_store(0, buffer, size);
+}
+
+static ssize_t fan2_show(struct device *child, struct device_attribute *attr, char *buffer)
+{
+	return uw_fan_curve_show(1, buffer);
+}
+
+static ssize_t fan2_store(struct device *child, struct device_attribute *attr,
+			  const char *buffer, size_t size)
+{
+	return uw_fan_curve_store(1, buffer, size);
+}
+
+static DEVICE_ATTR_RW(fan1);
+static DEVICE_ATTR_RW(fan2);
+
+static struct attribute *uw_fan_curve_attrs_list[] = {
+	&dev_attr_fan1.attr,
+	&dev_attr_fan2.attr,
+	NULL
+};
+
+static struct attribute_group uw_fan_curve_attr_group = {
+	.name = "fan_curve",
+	.attrs = uw_fan_curve_attrs_list
+};
+
+static bool uw_fan_curve_loaded = false;
+
+static void uw_fan_curve_init(struct platform_device *dev)
+{
+	struct uniwill_device_features_t *uw_feats = &uniwill_device_features;
+
+	if (uw_feats->uniwill_has_universal_ec_fan_control)
+		uw_fan_curve_loaded = sysfs_create_group(&dev->dev.kobj, &uw_fan_curve_attr_group) == 0;
+}
+
 static u8 uniwill_touchp_toggle_seq[] = {
 	0xe0, 0x5b, // Super down
 	0x1d,       // Control down
@@ -2158,11 +3387,15 @@ static bool uniwill_i8042_filter(unsigned char data, unsigned char str,
 
 static int uniwill_keyboard_probe(struct platform_device *dev)
 {
-	u32 i;
 	u8 data;
+	u8 fan_curve[5];
 	int status;
 	struct uniwill_device_features_t *uw_feats;
 
+	uw_debugfs_init();
+	direct_fan_control_debugfs_init();
+	uw_ec_queue_init();
+
 	set_rom_id();
 
 	uw_feats = uniwill_get_device_features();
@@ -2175,10 +3408,8 @@ static int uniwill_keyboard_probe(struct platform_device *dev)
 	if (uw_feats->uniwill_profile_v1) {
 		// Set manual-mode fan-curve in 0x0743 - 0x0747
 		// Some kind of default fan-curve is stored in 0x0786 - 0x078a: Using it to initialize manual-mode fan-curve
-		for (i = 0; i < 5; ++i) {
-			uniwill_read_ec_ram(0x0786 + i, &data);
-			uniwill_write_ec_ram(0x0743 + i, data);
-		}
+		if (uniwill_read_ec_ram_bulk(0x0786, fan_curve, sizeof(fan_curve)) == 0)
+			uniwill_write_ec_ram_bulk(0x0743, fan_curve, sizeof(fan_curve));
 	}
 
 	// Make sure custom TDP/custom fan curve mode is set. Using the
@@ -2207,6 +3438,7 @@ static int uniwill_keyboard_probe(struct platform_device *dev)
 	uw_ac_auto_boot_init(dev);
 	uw_usb_powershare_init(dev);
 	uw_mini_led_local_dimming_init(dev);
+	uw_fan_curve_init(dev);
 	uw_show_hidden_bios_options();
 	uw_battery_init();
 
@@ -2229,12 +3461,18 @@ static int uniwill_keyboard_remove(struct platform_device *dev)
 static void uniwill_keyboard_remove(struct platform_device *dev)
 #endif
 {
+	// Drain pending requests, everything below runs synchronously
+	uw_ec_queue_remove();
+
 	if (uw_charging_prio_loaded)
 		sysfs_remove_group(&dev->dev.kobj, &uw_charging_prio_attr_group);
 
 	if (uw_charging_profile_loaded)
 		sysfs_remove_group(&dev->dev.kobj, &uw_charging_profile_attr_group);
 
+	if (uw_fan_curve_loaded)
+		sysfs_remove_group(&dev->dev.kobj, &uw_fan_curve_attr_group);
+
 	uw_battery_uninit();
 
 	uniwill_leds_remove(dev);
@@ -2256,6 +3494,8 @@ static void uniwill_keyboard_remove(struct platform_device *dev)
 
 	cancel_delayed_work_sync(&direct_fan_control_restart_delayed_work);
 
+	uw_debugfs_remove();
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6, 11, 0)
 	return 0;
 #endif
@@ -2265,6 +3505,10 @@ static int uniwill_keyboard_suspend(struct platform_device *dev, pm_message_t st
 {
 	struct uniwill_device_features_t *uw_feats = &uniwill_device_features;
 	u8 data;
+
+	// Pending replays must not land after the suspend sequence
+	uniwill_ec_queue_flush();
+
 	if (uw_feats->uniwill_custom_profile_mode_needed) {
 		// Unset "customer mode light" before suspend. Otherwise at
 		// least one device is known to immediately wake up.
@@ -2282,17 +3526,15 @@ static int uniwill_keyboard_suspend(struct platform_device *dev, pm_message_t st
 	return 0;
 }
 
-static int uniwill_keyboard_resume(struct platform_device *dev)
+/**
+ * State restored after resume, runs on the EC queue so resume itself does not
+ * wait for the whole replay
+ */
+static void uw_resume_replay(void)
 {
 	struct uniwill_device_features_t *uw_feats = &uniwill_device_features;
 	u8 data;
 
-	if (direct_fan_control_suspend) {
-		direct_fan_control_suspend = false;
-		uw_set_fan(0, direct_fan_control_current_value_fan0_suspend_save);
-		uw_set_fan(1, direct_fan_control_current_value_fan1_suspend_save);
-	}
-
 	if (uw_feats->uniwill_custom_profile_mode_needed) {
 		// Re-set "customer mode light" on resume
 		uniwill_read_ec_ram(0x0727, &data);
@@ -2304,6 +3546,20 @@ static int uniwill_keyboard_resume(struct platform_device *dev)
 	// Restore charging settings on resume
 	uw_charging_priority_write_state();
 	uw_charging_profile_write_state();
+	uw_fan_curve_write_state();
+}
+
+static int uniwill_keyboard_resume(struct platform_device *dev)
+{
+	uniwill_ec_shadow_invalidate();
+
+	if (direct_fan_control_suspend) {
+		direct_fan_control_suspend = false;
+		uw_set_fan(0, direct_fan_control_current_value_fan0_suspend_save);
+		uw_set_fan(1, direct_fan_control_current_value_fan1_suspend_save);
+	}
+
+	uniwill_ec_queue_call(uw_resume_replay);
 	return 0;
 }
 
@@ -142,21 +142,26 @@ static int uniwill_write_kbd_bl_color(u8 red, u8 green, u8 blue)
 	return result;
 }
 
-static void uniwill_leds_set_brightness(struct led_classdev *led_cdev __always_unused, enum led_brightness brightness) {
+static struct led_classdev uniwill_led_cdev;
+static struct led_classdev_mc uniwill_mcled_cdev;
+
+/**
+ * Write the current white backlight state, runs on the EC queue. The LED core
+ * already stored the requested brightness before calling brightness_set.
+ */
+static void uniwill_leds_apply_brightness(void) {
 	int result = 0;
 
-	result = uniwill_write_kbd_bl_brightness_white_workaround(brightness);
+	result = uniwill_write_kbd_bl_brightness_white_workaround(uniwill_led_cdev.brightness);
 	if (result) {
 		pr_debug("uniwill_leds_set_brightness(): uniwill_write_kbd_bl_white() failed\n");
-		return;
 	}
-
-	led_cdev->brightness = brightness;
 }
 
-static void uniwill_leds_set_brightness_mc(struct led_classdev *led_cdev, enum led_brightness brightness) {
+static void uniwill_leds_apply_brightness_mc(void) {
 	int result = 0;
-	struct led_classdev_mc *mcled_cdev = lcdev_to_mccdev(led_cdev);
+	struct led_classdev_mc *mcled_cdev = &uniwill_mcled_cdev;
+	enum led_brightness brightness = mcled_cdev->led_cdev.brightness;
 
 	if (mcled_cdev->subled_info[0].intensity == 0 &&
 	    mcled_cdev->subled_info[1].intensity == 0 &&
@@ -183,8 +188,18 @@ static void uniwill_leds_set_brightness_mc(struct led_classdev *led_cdev, enum l
 			return;
 		}
 	}
+}
 
+static void uniwill_leds_set_brightness(struct led_classdev *led_cdev, enum led_brightness brightness) {
+	led_cdev->brightness = brightness;
+	if (uniwill_ec_queue_call(uniwill_leds_apply_brightness))
+		pr_debug("uniwill_leds_set_brightness(): uniwill_ec_queue_call() failed\n");
+}
+
+static void uniwill_leds_set_brightness_mc(struct led_classdev *led_cdev, enum led_brightness brightness) {
 	led_cdev->brightness = brightness;
+	if (uniwill_ec_queue_call(uniwill_leds_apply_brightness_mc))
+		pr_debug("uniwill_leds_set_brightness_mc(): uniwill_ec_queue_call() failed\n");
 }
 
 static struct led_classdev uniwill_led_cdev = {
@@ -0,0 +1,469 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*!
+ * Copyright (c) 2025 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-drivers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Simulated Uniwill EC interface
+ *
+ * Registers a RAM backed model of the 64 KiB EC address space as uniwill
+ * interface so that tuxedo_keyboard, tuxedo_io and the modules built on top
+ * can be loaded and benchmarked without TUXEDO hardware.
+ *
+ * Behaviour is scripted through debugfs (tuxedo_uniwill_sim/):
+ *   ram      raw EC RAM image, readable and writable at any offset
+ *   rules    one command per write, current rules on read
+ *              ro <addr>               writes fail with -EIO
+ *              latch <addr> <value>    reads return value, writes latch a new
+ *                                      value instead of changing RAM
+ *              busy <addr> <us>        per register access latency
+ *              fail <addr> <permille>  per register failure injection
+ *              clear                   remove all rules
+ *   event    write an event code to deliver it to the registered callback
+ *   reads, writes, failures  access counters
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/delay.h>
+#include <linux/random.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include "uniwill_interfaces.h"
+
+#define UW_SIM_RAM_SIZE		0x10000
+#define UW_SIM_MAX_RULES	64
+
+#define UW_SIM_RULE_RO		BIT(0)
+#define UW_SIM_RULE_LATCH	BIT(1)
+
+struct uw_sim_rule_t {
+	u16 address;
+	u8 flags;
+	u8 latch_value;
+	unsigned int latency_us;
+	unsigned int fail_permille;
+};
+
+static DEFINE_MUTEX(uw_sim_lock);
+static u8 uw_sim_ram[UW_SIM_RAM_SIZE];
+static struct uw_sim_rule_t uw_sim_rules[UW_SIM_MAX_RULES];
+static int uw_sim_rules_count;
+
+static unsigned int uw_sim_latency_us;
+static unsigned int uw_sim_fail_permille;
+static u8 uw_sim_barebone_id = UW_EC_REG_BAREBONE_ID_VALUE_PFxxxxx;
+
+static u64 uw_sim_reads;
+static u64 uw_sim_writes;
+static u64 uw_sim_failures;
+
+static struct dentry *uw_sim_debugfs_dir;
+
+static struct uw_sim_rule_t *uw_sim_find_rule(u16 address)
+{
+	int i;
+
+	for (i = 0; i < uw_sim_rules_count; ++i)
+		if (uw_sim_rules[i].address == address)
+			return &uw_sim_rules[i];
+
+	return NULL;
+}
+
+static struct uw_sim_rule_t *uw_sim_get_rule(u16 address)
+{
+	struct uw_sim_rule_t *rule = uw_sim_find_rule(address);
+
+	if (rule)
+		return rule;
+
+	if (uw_sim_rules_count >= UW_SIM_MAX_RULES)
+		return NULL;
+
+	rule = &uw_sim_rules[uw_sim_rules_count++];
+	memset(rule, 0, sizeof(*rule));
+	rule->address = address;
+
+	return rule;
+}
+
+/**
+ * Model access latency and failure injection, called with uw_sim_lock held
+ */
+static int uw_sim_access(u16 address, struct uw_sim_rule_t *rule)
+{
+	unsigned int latency_us = uw_sim_latency_us;
+	unsigned int fail_permille = uw_sim_fail_permille;
+	u32 rnd;
+
+	if (rule && rule->latency_us)
+		latency_us = rule->latency_us;
+	if (rule && rule->fail_permille)
+		fail_permille = rule->fail_permille;
+
+	if (latency_us)
+		usleep_range(latency_us, latency_us + latency_us / 8 + 1);
+
+	if (fail_permille) {
+		get_random_bytes(&rnd, sizeof(rnd));
+		if (rnd % 1000 < fail_permille) {
+			uw_sim_failures += 1;
+			pr_debug("injected failure at 0x%04x\n", address);
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
+static int __uw_sim_read_ec_ram(u16 address, u8 *data)
+{
+	struct uw_sim_rule_t *rule = uw_sim_find_rule(address);
+	int result;
+
+	uw_sim_reads += 1;
+	result = uw_sim_access(address, rule);
+	if (result)
+		return result;
+
+	if (rule && (rule->flags & UW_SIM_RULE_LATCH))
+		*data = rule->latch_value;
+	else
+		*data = uw_sim_ram[address];
+
+	return 0;
+}
+
+static int __uw_sim_write_ec_ram(u16 address, u8 data)
+{
+	struct uw_sim_rule_t *rule = uw_sim_find_rule(address);
+	int result;
+
+	uw_sim_writes += 1;
+	result = uw_sim_access(address, rule);
+	if (result)
+		return result;
+
+	if (rule && (rule->flags & UW_SIM_RULE_RO)) {
+		uw_sim_failures += 1;
+		return -EIO;
+	}
+
+	if (rule && (rule->flags & UW_SIM_RULE_LATCH))
+		rule->latch_value = data;
+	else
+		uw_sim_ram[address] = data;
+
+	return 0;
+}
+
+static int uw_sim_read_ec_ram(u16 address, u8 *data)
+{
+	int result;
+
+	if (IS_ERR_OR_NULL(data))
+		return -EINVAL;
+
+	mutex_lock(&uw_sim_lock);
+	result = __uw_sim_read_ec_ram(address, data);
+	mutex_unlock(&uw_sim_lock);
+
+	return result;
+}
+
+static int uw_sim_write_ec_ram(u16 address, u8 data)
+{
+	int result;
+
+	mutex_lock(&uw_sim_lock);
+	result = __uw_sim_write_ec_ram(address, data);
+	mutex_unlock(&uw_sim_lock);
+
+	return result;
+}
+
+static int uw_sim_read_ec_ram_bulk(u16 address, u8 *data, u16 len)
+{
+	int result = 0;
+	u16 i;
+
+	if (IS_ERR_OR_NULL(data))
+		return -EINVAL;
+
+	mutex_lock(&uw_sim_lock);
+	for (i = 0; i < len; ++i) {
+		result = __uw_sim_read_ec_ram(address + i, &data[i]);
+		if (result)
+			break;
+	}
+	mutex_unlock(&uw_sim_lock);
+
+	return result;
+}
+
+static int uw_sim_write_ec_ram_bulk(u16 address, const u8 *data, u16 len)
+{
+	int result = 0;
+	u16 i;
+
+	if (IS_ERR_OR_NULL(data))
+		return -EINVAL;
+
+	mutex_lock(&uw_sim_lock);
+	for (i = 0; i < len; ++i) {
+		result = __uw_sim_write_ec_ram(address + i, data[i]);
+		if (result)
+			break;
+	}
+	mutex_unlock(&uw_sim_lock);
+
+	return result;
+}
+
+static int uw_sim_read_ec_ram_multi(const u16 *addresses, u8 *data, u16 count)
+{
+	int result = 0;
+	u16 i;
+
+	if (IS_ERR_OR_NULL(addresses) || IS_ERR_OR_NULL(data))
+		return -EINVAL;
+
+	mutex_lock(&uw_sim_lock);
+	for (i = 0; i < count; ++i) {
+		result = __uw_sim_read_ec_ram(addresses[i], &data[i]);
+		if (result)
+			break;
+	}
+	mutex_unlock(&uw_sim_lock);
+
+	return result;
+}
+
+static struct uniwill_interface_t uniwill_sim_interface = {
+	.string_id = UNIWILL_INTERFACE_SIM_STRID,
+	.read_ec_ram = uw_sim_read_ec_ram,
+	.write_ec_ram = uw_sim_write_ec_ram,
+	.read_ec_ram_bulk = uw_sim_read_ec_ram_bulk,
+	.write_ec_ram_bulk = uw_sim_write_ec_ram_bulk,
+	.read_ec_ram_multi = uw_sim_read_ec_ram_multi,
+};
+
+static ssize_t uw_sim_ram_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+	ssize_t result;
+
+	mutex_lock(&uw_sim_lock);
+	result = simple_read_from_buffer(buf, count, ppos, uw_sim_ram, sizeof(uw_sim_ram));
+	mutex_unlock(&uw_sim_lock);
+
+	return result;
+}
+
+static ssize_t uw_sim_ram_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	ssize_t result;
+
+	mutex_lock(&uw_sim_lock);
+	result = simple_write_to_buffer(uw_sim_ram, sizeof(uw_sim_ram), ppos, buf, count);
+	mutex_unlock(&uw_sim_lock);
+
+	return result;
+}
+
+static const struct file_operations uw_sim_ram_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = uw_sim_ram_read,
+	.write = uw_sim_ram_write,
+	.llseek = default_llseek,
+};
+
+static int uw_sim_rules_show(struct seq_file *m, void *v)
+{
+	struct uw_sim_rule_t *rule;
+	int i;
+
+	mutex_lock(&uw_sim_lock);
+	for (i = 0; i < uw_sim_rules_count; ++i) {
+		rule = &uw_sim_rules[i];
+		if (rule->flags & UW_SIM_RULE_RO)
+			seq_printf(m, "ro 0x%04x\n", rule->address);
+		if (rule->flags & UW_SIM_RULE_LATCH)
+			seq_printf(m, "latch 0x%04x 0x%02x\n", rule->address, rule->latch_value);
+		if (rule->latency_us)
+			seq_printf(m, "busy 0x%04x %u\n", rule->address, rule->latency_us);
+		if (rule->fail_permille)
+			seq_printf(m, "fail 0x%04x %u\n", rule->address, rule->fail_permille);
+	}
+	mutex_unlock(&uw_sim_lock);
+
+	return 0;
+}
+
+static int uw_sim_rules_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uw_sim_rules_show, NULL);
+}
+
+static ssize_t uw_sim_rules_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	char line[64], cmd[8];
+	int address, arg = 0, fields;
+	struct uw_sim_rule_t *rule;
+	ssize_t result = count;
+
+	if (count >= sizeof(line))
+		return -EINVAL;
+	if (copy_from_user(line, buf, count))
+		return -EFAULT;
+	line[count] = '\0';
+
+	fields = sscanf(line, "%7s %i %i", cmd, &address, &arg);
+	if (fields < 1)
+		return -EINVAL;
+
+	mutex_lock(&uw_sim_lock);
+
+	if (strcmp(cmd, "clear") == 0) {
+		uw_sim_rules_count = 0;
+		goto out;
+	}
+
+	if (fields < 2 || address < 0 || address >= UW_SIM_RAM_SIZE) {
+		result = -EINVAL;
+		goto out;
+	}
+
+	if (strcmp(cmd, "ro") != 0 && fields < 3) {
+		result = -EINVAL;
+		goto out;
+	}
+
+	rule = uw_sim_get_rule(address);
+	if (!rule) {
+		result = -ENOSPC;
+		goto out;
+	}
+
+	if (strcmp(cmd, "ro") == 0) {
+		rule->flags |= UW_SIM_RULE_RO;
+	} else if (strcmp(cmd, "latch") == 0 && arg >= 0 && arg <= 0xff) {
+		rule->flags |= UW_SIM_RULE_LATCH;
+		rule->latch_value = arg;
+	} else if (strcmp(cmd, "busy") == 0 && arg >= 0) {
+		rule->latency_us = arg;
+	} else if (strcmp(cmd, "fail") == 0 && arg >= 0 && arg <= 1000) {
+		rule->fail_permille = arg;
+	} else {
+		result = -EINVAL;
+	}
+
+out:
+	mutex_unlock(&uw_sim_lock);
+
+	return result;
+}
+
+static const struct file_operations uw_sim_rules_fops = {
+	.owner = THIS_MODULE,
+	.open = uw_sim_rules_open,
+	.read = seq_read,
+	.write = uw_sim_rules_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static ssize_t uw_sim_event_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	u32 code;
+	int result;
+
+	result = kstrtou32_from_user(buf, count, 0, &code);
+	if (result)
+		return result;
+
+	if (IS_ERR_OR_NULL(uniwill_sim_interface.event_callb))
+		return -ENODEV;
+
+	uniwill_sim_interface.event_callb(code);
+
+	return count;
+}
+
+static const struct file_operations uw_sim_event_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.write = uw_sim_event_write,
+	.llseek = noop_llseek,
+};
+
+static void uw_sim_debugfs_init(void)
+{
+	uw_sim_debugfs_dir = debugfs_create_dir("tuxedo_uniwill_sim", NULL);
+	debugfs_create_file("ram", 0600, uw_sim_debugfs_dir, NULL, &uw_sim_ram_fops);
+	debugfs_create_file("rules", 0600, uw_sim_debugfs_dir, NULL, &uw_sim_rules_fops);
+	debugfs_create_file("event", 0200, uw_sim_debugfs_dir, NULL, &uw_sim_event_fops);
+	debugfs_create_u64("reads", 0444, uw_sim_debugfs_dir, &uw_sim_reads);
+	debugfs_create_u64("writes", 0444, uw_sim_debugfs_dir, &uw_sim_writes);
+	debugfs_create_u64("failures", 0444, uw_sim_debugfs_dir, &uw_sim_failures);
+}
+
+static int __init uniwill_sim_init(void)
+{
+	int result;
+
+	uw_sim_ram[UW_EC_REG_BAREBONE_ID] = uw_sim_barebone_id;
+
+	uw_sim_debugfs_init();
+
+	result = uniwill_add_interface(&uniwill_sim_interface);
+	if (result) {
+		pr_err("could not register interface (%d)\n", result);
+		debugfs_remove_recursive(uw_sim_debugfs_dir);
+		return result;
+	}
+
+	pr_info("simulated interface initialized\n");
+
+	return 0;
+}
+
+static void __exit uniwill_sim_exit(void)
+{
+	uniwill_remove_interface(&uniwill_sim_interface);
+	debugfs_remove_recursive(uw_sim_debugfs_dir);
+}
+
+module_init(uniwill_sim_init);
+module_exit(uniwill_sim_exit);
+
+MODULE_AUTHOR("TUXEDO Computers GmbH <tux@tuxedocomputers.com>");
+MODULE_DESCRIPTION("Simulated Uniwill EC interface for testing without hardware");
+MODULE_LICENSE("GPL");
+
+module_param_named(latency_us, uw_sim_latency_us, uint, S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(latency_us, "Default busy latency per EC access in microseconds (default: 0).");
+
+module_param_named(fail_permille, uw_sim_fail_permille, uint, S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(fail_permille, "Default failure probability per EC access in 1/1000 (default: 0).");
+
+module_param_named(barebone_id, uw_sim_barebone_id, byte, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(barebone_id, "Initial value of the barebone ID register.");
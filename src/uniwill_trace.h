@@ -0,0 +1,103 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*!
+ * Copyright (c) 2025 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-drivers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tuxedo_uniwill
+
+#if !defined(UNIWILL_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define UNIWILL_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * Single EC RAM access through the direct EC interface. Retries counts the
+ * additional polls of the ready flag.
+ */
+DECLARE_EVENT_CLASS(uniwill_ec_access,
+
+	TP_PROTO(u16 address, u8 value, u64 duration_ns, int retries, int status),
+
+	TP_ARGS(address, value, duration_ns, retries, status),
+
+	TP_STRUCT__entry(
+		__field(u16, address)
+		__field(u8, value)
+		__field(u64, duration_ns)
+		__field(int, retries)
+		__field(int, status)
+	),
+
+	TP_fast_assign(
+		__entry->address = address;
+		__entry->value = value;
+		__entry->duration_ns = duration_ns;
+		__entry->retries = retries;
+		__entry->status = status;
+	),
+
+	TP_printk("addr=0x%04x value=0x%02x duration_ns=%llu retries=%d status=%d",
+		  __entry->address, __entry->value, __entry->duration_ns,
+		  __entry->retries, __entry->status)
+);
+
+DEFINE_EVENT(uniwill_ec_access, uniwill_ec_read_direct,
+	TP_PROTO(u16 address, u8 value, u64 duration_ns, int retries, int status),
+	TP_ARGS(address, value, duration_ns, retries, status)
+);
+
+DEFINE_EVENT(uniwill_ec_access, uniwill_ec_write_direct,
+	TP_PROTO(u16 address, u8 value, u64 duration_ns, int retries, int status),
+	TP_ARGS(address, value, duration_ns, retries, status)
+);
+
+TRACE_EVENT(uniwill_wmi_evaluate,
+
+	TP_PROTO(u8 function, u32 arg, u32 result, u64 duration_ns, int status),
+
+	TP_ARGS(function, arg, result, duration_ns, status),
+
+	TP_STRUCT__entry(
+		__field(u8, function)
+		__field(u32, arg)
+		__field(u32, result)
+		__field(u64, duration_ns)
+		__field(int, status)
+	),
+
+	TP_fast_assign(
+		__entry->function = function;
+		__entry->arg = arg;
+		__entry->result = result;
+		__entry->duration_ns = duration_ns;
+		__entry->status = status;
+	),
+
+	TP_printk("function=%u arg=0x%08x result=0x%08x duration_ns=%llu status=%d",
+		  __entry->function, __entry->arg, __entry->result,
+		  __entry->duration_ns, __entry->status)
+);
+
+#endif // UNIWILL_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE uniwill_trace
+#include <trace/define_trace.h>
@@ -24,8 +24,12 @@
 #include <linux/wmi.h>
 #include <linux/version.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include "uniwill_interfaces.h"
 
+#define CREATE_TRACE_POINTS
+#include "uniwill_trace.h"
+
 #define UNIWILL_EC_REG_LDAT	0x8a
 #define UNIWILL_EC_REG_HDAT	0x8b
 #define UNIWILL_EC_REG_FLAGS	0x8c
@@ -41,7 +45,35 @@
 #define UW_EC_BUSY_WAIT_CYCLES	30
 #define UW_EC_BUSY_WAIT_DELAY	15
 
+/*
+ * Adaptive DRDY wait: the first poll is scheduled at half the observed ready
+ * latency, then the poll interval doubles up to UW_EC_WAIT_MAX_US. The total
+ * time budget matches the legacy 30 x 15 ms loop.
+ */
+#define UW_EC_WAIT_MIN_US	10
+#define UW_EC_WAIT_MAX_US	(UW_EC_BUSY_WAIT_DELAY * 1000)
+#define UW_EC_WAIT_TIMEOUT_US	(UW_EC_BUSY_WAIT_CYCLES * UW_EC_BUSY_WAIT_DELAY * 1000)
+#define UW_EC_WAIT_INITIAL_US	500
+
+/*
+ * Path selection at probe: the barebone ID register never changes at runtime
+ * and is read a few times through both paths.
+ */
+#define UW_EC_CALIBRATION_ADDR	UW_EC_REG_BAREBONE_ID
+#define UW_EC_CALIBRATION_READS	4
+
 static bool uniwill_ec_direct = false;
+// Set when ec_direct_io is given explicitly, skips the probe time path selection
+static bool uniwill_ec_direct_forced = false;
+static bool uniwill_ec_adaptive_wait = true;
+
+// Running average (1/8 weight) of the observed DRDY latency, protected by uniwill_ec_lock
+static unsigned int uw_ec_ready_latency_us = UW_EC_WAIT_INITIAL_US;
+
+#ifdef DEBUG
+// Artificial ready latency injected in front of the DRDY flag for benchmarking
+static unsigned int uw_ec_mock_ready_latency_us = 0;
+#endif
 
 DEFINE_MUTEX(uniwill_ec_lock);
 
@@ -52,12 +84,16 @@ DEFINE_MUTEX(uniwill_ec_lock);
  * 5: Apparently used for toggling features. Currently only used for toggling
  * the NB02 local dimming feature (only possible via WMI). It is unclear what
  * other functionalities this might have.
+ *
+ * Has to be called with uniwill_ec_lock held.
  */
-static int uw_wmi_ec_evaluate(u8 function, u32 arg, u32 *return_buffer)
+static int __uw_wmi_ec_evaluate(u8 function, u32 arg, u32 *return_buffer)
 {
 	acpi_status status;
 	union acpi_object *out_acpi;
 	int e_result = 0;
+	u32 trace_result = 0;
+	u64 start_ns = ktime_get_ns();
 
 	// Kernel buffer for input argument
 	u32 *wmi_arg = (u32 *) kmalloc(sizeof(u32)*10, GFP_KERNEL);
@@ -69,8 +105,6 @@ static int uw_wmi_ec_evaluate(u8 function, u32 arg, u32 *return_buffer)
 	struct acpi_buffer wmi_in = { (acpi_size) sizeof(wmi_arg), wmi_arg};
 	struct acpi_buffer wmi_out = { ACPI_ALLOCATE_BUFFER, NULL };
 
-	mutex_lock(&uniwill_ec_lock);
-
 	// Zero input buffer
 	memset(wmi_arg, 0x00, 10 * sizeof(u32));
 
@@ -84,6 +118,8 @@ static int uw_wmi_ec_evaluate(u8 function, u32 arg, u32 *return_buffer)
 
 	if (out_acpi && out_acpi->type == ACPI_TYPE_BUFFER) {
 		memcpy(return_buffer, out_acpi->buffer.pointer, out_acpi->buffer.length);
+		if (out_acpi->buffer.length >= sizeof(u32))
+			trace_result = return_buffer[0];
 	} /* else if (out_acpi && out_acpi->type == ACPI_TYPE_INTEGER) {
 		e_result = (u32) out_acpi->integer.value;
 	}*/
@@ -95,20 +131,100 @@ static int uw_wmi_ec_evaluate(u8 function, u32 arg, u32 *return_buffer)
 	kfree(out_acpi);
 	kfree(wmi_arg);
 
-	mutex_unlock(&uniwill_ec_lock);
+	trace_uniwill_wmi_evaluate(function, arg, trace_result, ktime_get_ns() - start_ns, e_result);
 
 	return e_result;
 }
 
+static int uw_wmi_ec_evaluate(u8 function, u32 arg, u32 *return_buffer)
+{
+	int result;
+
+	mutex_lock(&uniwill_ec_lock);
+	result = __uw_wmi_ec_evaluate(function, arg, return_buffer);
+	mutex_unlock(&uniwill_ec_lock);
+
+	return result;
+}
+
+static bool uw_ec_drdy_set(ktime_t start)
+{
+	u8 flags;
+
+#ifdef DEBUG
+	if (ktime_us_delta(ktime_get(), start) < uw_ec_mock_ready_latency_us)
+		return false;
+#endif
+	ec_read(UNIWILL_EC_REG_FLAGS, &flags);
+	return (flags & (1 << UNIWILL_EC_BIT_DRDY)) != 0;
+}
+
+/**
+ * Legacy fixed delay wait for the DRDY flag. Returns the number of
+ * used wait cycles or -ETIMEDOUT.
+ */
+static int uw_ec_wait_ready_fixed(ktime_t start)
+{
+	int count = 0;
+
+	while (count < UW_EC_BUSY_WAIT_CYCLES) {
+		msleep(UW_EC_BUSY_WAIT_DELAY);
+		count += 1;
+		if (uw_ec_drdy_set(start))
+			return count;
+	}
+
+	return -ETIMEDOUT;
+}
+
+/**
+ * Adaptive wait for the DRDY flag with exponential backoff. Returns the
+ * number of polls needed or -ETIMEDOUT. Has to be called with
+ * uniwill_ec_lock held.
+ */
+static int uw_ec_wait_ready_adaptive(ktime_t start)
+{
+	int count = 0;
+	unsigned int delay_us = max_t(unsigned int, uw_ec_ready_latency_us / 2, UW_EC_WAIT_MIN_US);
+	s64 elapsed_us;
+
+	for (;;) {
+		usleep_range(delay_us, delay_us + delay_us / 2);
+		count += 1;
+		elapsed_us = ktime_us_delta(ktime_get(), start);
+		if (uw_ec_drdy_set(start))
+			break;
+		if (elapsed_us >= UW_EC_WAIT_TIMEOUT_US)
+			return -ETIMEDOUT;
+		delay_us = min_t(unsigned int, delay_us * 2, UW_EC_WAIT_MAX_US);
+	}
+
+	uw_ec_ready_latency_us = (uw_ec_ready_latency_us * 7 + (unsigned int)elapsed_us) / 8;
+	if (uw_ec_ready_latency_us < UW_EC_WAIT_MIN_US)
+		uw_ec_ready_latency_us = UW_EC_WAIT_MIN_US;
+
+	return count;
+}
+
+static int uw_ec_wait_ready(void)
+{
+	ktime_t start = ktime_get();
+
+	if (uniwill_ec_adaptive_wait)
+		return uw_ec_wait_ready_adaptive(start);
+	else
+		return uw_ec_wait_ready_fixed(start);
+}
+
 /**
- * EC address read through WMI
+ * EC address read through WMI, caller has to hold uniwill_ec_lock
  */
 static int uw_ec_read_addr_wmi(u8 addr_low, u8 addr_high, union uw_ec_read_return *output)
 {
 	u32 uw_data[10];
 	u32 arg = ((u32)addr_high << 8) | ((u32)addr_low);
 
-	int ret = uw_wmi_ec_evaluate(UNIWILL_WMI_FUNCTION_READ, arg, uw_data);
+	int ret = __uw_wmi_ec_evaluate(UNIWILL_WMI_FUNCTION_READ, arg, uw_data);
 	output->dword = uw_data[0];
 
 	if (output->dword == 0xfefefefe) {
@@ -121,7 +237,7 @@ static int uw_ec_read_addr_wmi(u8 addr_low, u8 addr_high, union uw_ec_read_retur
 }
 
 /**
- * EC address write through WMI
+ * EC address write through WMI, caller has to hold uniwill_ec_lock
  */
 static int uw_ec_write_addr_wmi(u8 addr_low, u8 addr_high, u8 data_low, u8 data_high, union uw_ec_write_return *output)
 {
@@ -129,7 +245,7 @@ static int uw_ec_write_addr_wmi(u8 addr_low, u8 addr_high, u8 data_low, u8 data_
 	u32 arg = ((u32)data_high << 24) | ((u32)data_low << 16) |
 		  ((u32)addr_high << 8) | ((u32)addr_low);
 
-	int ret = uw_wmi_ec_evaluate(UNIWILL_WMI_FUNCTION_WRITE, arg, uw_data);
+	int ret = __uw_wmi_ec_evaluate(UNIWILL_WMI_FUNCTION_WRITE, arg, uw_data);
 	output->dword = uw_data[0];
 
 	if (output->dword == 0xfefefefe) {
@@ -141,17 +257,15 @@ static int uw_ec_write_addr_wmi(u8 addr_low, u8 addr_high, u8 data_low, u8 data_
 }
 
 /**
- * Direct EC address read
+ * Direct EC address read, caller has to hold uniwill_ec_lock
  */
 static int uw_ec_read_addr_direct(u8 addr_low, u8 addr_high, union uw_ec_read_return *output)
 {
 	int result;
 	int count;
 	u8 tmp, flags;
-	bool ready;
 	bool bflag = false;
-
-	mutex_lock(&uniwill_ec_lock);
+	u64 start_ns = ktime_get_ns();
 
 	ec_read(UNIWILL_EC_REG_FLAGS, &flags);
 	if ((flags & (1 << UNIWILL_EC_BIT_BFLG)) > 0) {
@@ -170,16 +284,9 @@ static int uw_ec_read_addr_direct(u8 addr_low, u8 addr_high, union uw_ec_read_re
 	ec_write(UNIWILL_EC_REG_FLAGS, flags);
 
 	// Wait for ready flag
-	count = UW_EC_BUSY_WAIT_CYCLES;
-	ready = false;
-	while (!ready && count != 0) {
-		msleep(UW_EC_BUSY_WAIT_DELAY);
-		ec_read(UNIWILL_EC_REG_FLAGS, &tmp);
-		ready = (tmp & (1 << UNIWILL_EC_BIT_DRDY)) != 0;
-		count -= 1;
-	}
+	count = uw_ec_wait_ready();
 
-	if (count != 0) {
+	if (count > 0) {
 		output->dword = 0;
 		ec_read(UNIWILL_EC_REG_CMDL, &tmp);
 		output->bytes.data_low = tmp;
@@ -194,28 +301,30 @@ static int uw_ec_read_addr_direct(u8 addr_low, u8 addr_high, union uw_ec_read_re
 
 	ec_write(UNIWILL_EC_REG_FLAGS, 0x00);
 
-	mutex_unlock(&uniwill_ec_lock);
-
 	if (bflag)
 		pr_debug("addr: 0x%02x%02x value: %0#4x result: %d\n", addr_high, addr_low, output->bytes.data_low, result);
 
-	if ((UW_EC_BUSY_WAIT_CYCLES - count) > 1)
-		pr_debug("read wait count: %i", (UW_EC_BUSY_WAIT_CYCLES - count));
+	if (count > 1)
+		pr_debug("read wait count: %i, avg latency: %uus\n", count, uw_ec_ready_latency_us);
+
+	trace_uniwill_ec_read_direct(((u16)addr_high << 8) | addr_low, output->bytes.data_low,
+				     ktime_get_ns() - start_ns, count > 0 ? count - 1 : 0, result);
 
 	// pr_debug("addr: 0x%02x%02x value: %0#4x result: %d\n", addr_high, addr_low, output->bytes.data_low, result);
 
 	return result;
 }
 
+/**
+ * Direct EC address write, caller has to hold uniwill_ec_lock
+ */
 static int uw_ec_write_addr_direct(u8 addr_low, u8 addr_high, u8 data_low, u8 data_high, union uw_ec_write_return *output)
 {
 	int result = 0;
 	int count;
 	u8 tmp, flags;
-	bool ready;
 	bool bflag = false;
-
-	mutex_lock(&uniwill_ec_lock);
+	u64 start_ns = ktime_get_ns();
 
 	ec_read(UNIWILL_EC_REG_FLAGS, &flags);
 	if ((flags & (1 << UNIWILL_EC_BIT_BFLG)) > 0) {
@@ -236,17 +345,10 @@ static int uw_ec_write_addr_direct(u8 addr_low, u8 addr_high, u8 data_low, u8 da
 	ec_write(UNIWILL_EC_REG_FLAGS, flags);
 
 	// Wait for ready flag
-	count = UW_EC_BUSY_WAIT_CYCLES;
-	ready = false;
-	while (!ready && count != 0) {
-		msleep(UW_EC_BUSY_WAIT_DELAY);
-		ec_read(UNIWILL_EC_REG_FLAGS, &tmp);
-		ready = (tmp & (1 << UNIWILL_EC_BIT_DRDY)) != 0;
-		count -= 1;
-	}
+	count = uw_ec_wait_ready();
 
 	// Replicate wmi output depending on success
-	if (count != 0) {
+	if (count > 0) {
 		output->bytes.addr_low = addr_low;
 		output->bytes.addr_high = addr_high;
 		output->bytes.data_low = data_low;
@@ -263,23 +365,21 @@ static int uw_ec_write_addr_direct(u8 addr_low, u8 addr_high, u8 data_low, u8 da
 	if (bflag)
 		pr_debug("addr: 0x%02x%02x value: %0#4x result: %d\n", addr_high, addr_low, data_low, result);
 
-	if ((UW_EC_BUSY_WAIT_CYCLES - count) > 1)
-		pr_debug("write wait count: %i", (UW_EC_BUSY_WAIT_CYCLES - count));
+	if (count > 1)
+		pr_debug("write wait count: %i, avg latency: %uus\n", count, uw_ec_ready_latency_us);
 
-	mutex_unlock(&uniwill_ec_lock);
+	trace_uniwill_ec_write_direct(((u16)addr_high << 8) | addr_low, data_low,
+				      ktime_get_ns() - start_ns, count > 0 ? count - 1 : 0, result);
 
 	return result;
 }
 
-static int uw_wmi_read_ec_ram(u16 addr, u8 *data)
+static int __uw_wmi_read_ec_ram(u16 addr, u8 *data)
 {
 	int result;
 	u8 addr_low, addr_high;
 	union uw_ec_read_return output;
 
-	if (IS_ERR_OR_NULL(data))
-		return -EINVAL;
-
 	addr_low = addr & 0xff;
 	addr_high = (addr >> 8) & 0xff;
 
@@ -293,7 +393,7 @@ static int uw_wmi_read_ec_ram(u16 addr, u8 *data)
 	return result;
 }
 
-static int uw_wmi_write_ec_ram(u16 addr, u8 data)
+static int __uw_wmi_write_ec_ram(u16 addr, u8 data)
 {
 	int result;
 	u8 addr_low, addr_high, data_low, data_high;
@@ -312,10 +412,203 @@ static int uw_wmi_write_ec_ram(u16 addr, u8 data)
 	return result;
 }
 
+static int uw_wmi_read_ec_ram(u16 addr, u8 *data)
+{
+	int result;
+
+	if (IS_ERR_OR_NULL(data))
+		return -EINVAL;
+
+	mutex_lock(&uniwill_ec_lock);
+	result = __uw_wmi_read_ec_ram(addr, data);
+	mutex_unlock(&uniwill_ec_lock);
+
+	return result;
+}
+
+static int uw_wmi_write_ec_ram(u16 addr, u8 data)
+{
+	int result;
+
+	mutex_lock(&uniwill_ec_lock);
+	result = __uw_wmi_write_ec_ram(addr, data);
+	mutex_unlock(&uniwill_ec_lock);
+
+	return result;
+}
+
+/**
+ * Read a contiguous EC RAM range while holding uniwill_ec_lock only once
+ */
+static int uw_wmi_read_ec_ram_bulk(u16 addr, u8 *data, u16 len)
+{
+	int result = 0;
+	u16 i;
+
+	if (IS_ERR_OR_NULL(data))
+		return -EINVAL;
+
+	mutex_lock(&uniwill_ec_lock);
+	for (i = 0; i < len; ++i) {
+		result = __uw_wmi_read_ec_ram(addr + i, &data[i]);
+		if (result)
+			break;
+	}
+	mutex_unlock(&uniwill_ec_lock);
+
+	return result;
+}
+
+/**
+ * Write a contiguous EC RAM range while holding uniwill_ec_lock only once
+ */
+static int uw_wmi_write_ec_ram_bulk(u16 addr, const u8 *data, u16 len)
+{
+	int result = 0;
+	u16 i;
+
+	if (IS_ERR_OR_NULL(data))
+		return -EINVAL;
+
+	mutex_lock(&uniwill_ec_lock);
+	for (i = 0; i < len; ++i) {
+		result = __uw_wmi_write_ec_ram(addr + i, data[i]);
+		if (result)
+			break;
+	}
+	mutex_unlock(&uniwill_ec_lock);
+
+	return result;
+}
+
+static int uw_wmi_read_ec_ram_multi(const u16 *addresses, u8 *data, u16 count)
+{
+	int result = 0;
+	u16 i;
+
+	if (IS_ERR_OR_NULL(addresses) || IS_ERR_OR_NULL(data))
+		return -EINVAL;
+
+	mutex_lock(&uniwill_ec_lock);
+	for (i = 0; i < count; ++i) {
+		result = __uw_wmi_read_ec_ram(addresses[i], &data[i]);
+		if (result)
+			break;
+	}
+	mutex_unlock(&uniwill_ec_lock);
+
+	return result;
+}
+
+/**
+ * Average latency in us of UW_EC_CALIBRATION_READS reads through one path or a
+ * negative error if a read fails or the values differ. Has to be called with
+ * uniwill_ec_lock held.
+ */
+static int uw_ec_calibrate_path(bool direct, u8 *value)
+{
+	union uw_ec_read_return output;
+	u8 addr_low = UW_EC_CALIBRATION_ADDR & 0xff;
+	u8 addr_high = (UW_EC_CALIBRATION_ADDR >> 8) & 0xff;
+	ktime_t start;
+	s64 total_us = 0;
+	int i, result;
+
+	for (i = 0; i < UW_EC_CALIBRATION_READS; ++i) {
+		start = ktime_get();
+		if (direct)
+			result = uw_ec_read_addr_direct(addr_low, addr_high, &output);
+		else
+			result = uw_ec_read_addr_wmi(addr_low, addr_high, &output);
+		total_us += ktime_us_delta(ktime_get(), start);
+
+		if (result)
+			return result;
+		if (i > 0 && output.bytes.data_low != *value)
+			return -EIO;
+		*value = output.bytes.data_low;
+	}
+
+	return (int)div_s64(total_us, UW_EC_CALIBRATION_READS);
+}
+
+// Measured calibration latency per path, -1 if the path failed or was not measured
+static int uw_ec_latency_wmi_us = -1;
+static int uw_ec_latency_direct_us = -1;
+
+/**
+ * Pick the faster of the direct and the WMI path. Direct access is only used if
+ * it is consistent in itself and agrees with WMI, or if WMI does not work at all.
+ */
+static void uw_ec_select_path(void)
+{
+	u8 value_wmi = 0, value_direct = 0;
+
+	if (uniwill_ec_direct_forced) {
+		pr_info("ec path forced to %s\n", uniwill_ec_direct ? "direct" : "wmi");
+		return;
+	}
+
+	mutex_lock(&uniwill_ec_lock);
+	uw_ec_latency_wmi_us = uw_ec_calibrate_path(false, &value_wmi);
+	uw_ec_latency_direct_us = uw_ec_calibrate_path(true, &value_direct);
+	mutex_unlock(&uniwill_ec_lock);
+
+	if (uw_ec_latency_wmi_us < 0)
+		uw_ec_latency_wmi_us = -1;
+	if (uw_ec_latency_direct_us < 0)
+		uw_ec_latency_direct_us = -1;
+
+	if (uw_ec_latency_direct_us >= 0 &&
+	    (uw_ec_latency_wmi_us < 0 ||
+	     (value_direct == value_wmi && uw_ec_latency_direct_us < uw_ec_latency_wmi_us)))
+		uniwill_ec_direct = true;
+	else
+		uniwill_ec_direct = false;
+
+	pr_info("ec path: %s (wmi: %dus, direct: %dus)\n", uniwill_ec_direct ? "direct" : "wmi",
+		uw_ec_latency_wmi_us, uw_ec_latency_direct_us);
+}
+
+static ssize_t ec_io_path_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%s\n", uniwill_ec_direct ? "direct" : "wmi");
+}
+
+static ssize_t ec_latency_wmi_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", uw_ec_latency_wmi_us);
+}
+
+static ssize_t ec_latency_direct_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", uw_ec_latency_direct_us);
+}
+
+static DEVICE_ATTR_RO(ec_io_path);
+static DEVICE_ATTR_RO(ec_latency_wmi_us);
+static DEVICE_ATTR_RO(ec_latency_direct_us);
+
+static struct attribute *uw_ec_path_attrs[] = {
+	&dev_attr_ec_io_path.attr,
+	&dev_attr_ec_latency_wmi_us.attr,
+	&dev_attr_ec_latency_direct_us.attr,
+	NULL
+};
+
+static struct attribute_group uw_ec_path_attr_group = {
+	.attrs = uw_ec_path_attrs
+};
+
+static bool uw_ec_path_attrs_loaded = false;
+
 struct uniwill_interface_t uniwill_wmi_interface = {
 	.string_id = UNIWILL_INTERFACE_WMI_STRID,
 	.read_ec_ram = uw_wmi_read_ec_ram,
 	.write_ec_ram = uw_wmi_write_ec_ram,
+	.read_ec_ram_bulk = uw_wmi_read_ec_ram_bulk,
+	.write_ec_ram_bulk = uw_wmi_write_ec_ram_bulk,
+	.read_ec_ram_multi = uw_wmi_read_ec_ram_multi,
 	.wmi_evaluate = uw_wmi_ec_evaluate
 };
 
@@ -341,7 +634,17 @@ static int uniwill_wmi_probe(struct wmi_device *wdev, const void *dummy_context)
 		return -ENODEV;
 	}
 
-	uniwill_add_interface(&uniwill_wmi_interface);
+	uw_ec_select_path();
+	uw_ec_path_attrs_loaded = sysfs_create_group(&wdev->dev.kobj, &uw_ec_path_attr_group) == 0;
+
+	status = uniwill_add_interface(&uniwill_wmi_interface);
+	if (status) {
+		pr_err("add interface failed (%d)\n", status);
+		if (uw_ec_path_attrs_loaded)
+			sysfs_remove_group(&wdev->dev.kobj, &uw_ec_path_attr_group);
+		uw_ec_path_attrs_loaded = false;
+		return status;
+	}
 
 	pr_info("interface initialized\n");
 
@@ -356,6 +659,8 @@ static void uniwill_wmi_remove(struct wmi_device *wdev)
 {
 	pr_debug("uniwill_wmi driver remove\n");
 	uniwill_remove_interface(&uniwill_wmi_interface);
+	if (uw_ec_path_attrs_loaded)
+		sysfs_remove_group(&wdev->dev.kobj, &uw_ec_path_attr_group);
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5, 13, 0)
 	return 0;
 #endif
@@ -406,6 +711,21 @@ MODULE_AUTHOR("TUXEDO Computers GmbH <tux@tuxedocomputers.com>");
 MODULE_DESCRIPTION("Driver for Uniwill WMI interface");
 MODULE_LICENSE("GPL");
 
+static int uw_ec_direct_param_set(const char *val, const struct kernel_param *kp)
+{
+	int result = param_set_bool(val, kp);
+
+	if (result == 0)
+		uniwill_ec_direct_forced = true;
+
+	return result;
+}
+
+static const struct kernel_param_ops param_ops_ec_direct = {
+	.set = uw_ec_direct_param_set,
+	.get = param_get_bool,
+};
+
 /*
  * If set to true, the module will use the replicated WMI functions
  * (direct ec_read/ec_write) to read and write to the EC RAM instead
@@ -413,11 +733,30 @@ MODULE_LICENSE("GPL");
  *
  * The original functions didn't use to be
  * preferred since they use large delays in the I/O loop. However,
- * they have proven to be more stable and are therefore set as
- * the current default.
+ * they have proven to be more stable and are therefore the fallback.
+ *
+ * If not given, both paths are timed on a static register at probe and
+ * the faster one is used as long as both return the same data. Setting
+ * the parameter, at load time or later, overrides that choice.
  */
-module_param_cb(ec_direct_io, &param_ops_bool, &uniwill_ec_direct, S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH);
-MODULE_PARM_DESC(ec_direct_io, "Do not use WMI methods to read/write EC RAM (default: false).");
+module_param_cb(ec_direct_io, &param_ops_ec_direct, &uniwill_ec_direct, S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(ec_direct_io, "Do not use WMI methods to read/write EC RAM (default: auto selected at probe).");
+
+/*
+ * Poll the ready flag of direct EC transactions with an exponential backoff
+ * starting at the observed average latency instead of fixed 15 ms sleeps.
+ * Can be disabled to compare against the legacy behaviour.
+ */
+module_param_cb(ec_direct_adaptive_wait, &param_ops_bool, &uniwill_ec_adaptive_wait, S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(ec_direct_adaptive_wait, "Use adaptive ready flag polling for direct EC I/O (default: true).");
+
+module_param_named(ec_direct_ready_latency_us, uw_ec_ready_latency_us, uint, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(ec_direct_ready_latency_us, "Observed average ready latency of direct EC I/O (read-only).");
+
+#ifdef DEBUG
+module_param_named(ec_direct_mock_latency_us, uw_ec_mock_ready_latency_us, uint, S_IWUSR | S_IRUSR);
+MODULE_PARM_DESC(ec_direct_mock_latency_us, "Inject an artificial ready latency into direct EC I/O (debug only).");
+#endif
 
 MODULE_DEVICE_TABLE(wmi, uniwill_wmi_device_ids);
 MODULE_ALIAS_UNIWILL_WMI();